@@ -0,0 +1,337 @@
+#include <batch.h>
+#include <threadpool.h>
+#include <tx_file.h>
+
+#include <crypto/sha256.h>
+#include <streams.h>
+#include <tinyformat.h>
+#include <utilstrencodings.h>
+
+#include <unordered_map>
+
+static std::vector<std::string> split_fields(const std::string& line) {
+    std::vector<std::string> fields;
+    size_t pos = 0;
+    while (pos < line.size()) {
+        size_t start = line.find_first_not_of(" \t\r\n", pos);
+        if (start == std::string::npos) break;
+        size_t end = line.find_first_of(" \t\r\n", start);
+        if (end == std::string::npos) end = line.size();
+        fields.push_back(line.substr(start, end - start));
+        pos = end;
+    }
+    return fields;
+}
+
+/**
+ * Parse a record, leaving its transaction in mtx, unhashed: record.tx and
+ * record.txdata are not set.
+ */
+static bool parse_batch_record(const std::string& line, CMutableTransaction& mtx, BatchRecord& record, std::string& error) {
+    std::vector<std::string> fields = split_fields(line);
+    if (fields.size() < 3 || !(fields.size() & 1)) {
+        error = "expected <tx hex> followed by one <scriptPubKey hex> <amount> pair per input";
+        return false;
+    }
+    if (!IsHex(fields[0])) {
+        error = "failed to parse tx hex string";
+        return false;
+    }
+    std::vector<unsigned char> txData = ParseHex(fields[0]);
+    try {
+        SpanReader ss(SER_DISK, 0, Span<const unsigned char>(txData.data(), txData.size()));
+        UnserializeTransaction(mtx, ss);
+        if (!ss.empty()) {
+            error = "trailing data after transaction";
+            return false;
+        }
+    } catch (const std::exception& ex) {
+        error = std::string("failed to deserialize transaction: ") + ex.what();
+        return false;
+    }
+    size_t pairs = (fields.size() - 1) / 2;
+    if (pairs != mtx.vin.size()) {
+        error = strprintf("transaction has %zu inputs, but %zu scriptPubKey/amount pairs were given", mtx.vin.size(), pairs);
+        return false;
+    }
+    record.spent_scripts.clear();
+    record.amounts.clear();
+    for (size_t i = 1; i < fields.size(); i += 2) {
+        if (!IsHex(fields[i])) {
+            error = strprintf("failed to parse scriptPubKey hex string %s", fields[i]);
+            return false;
+        }
+        std::vector<unsigned char> scriptData = ParseHex(fields[i]);
+        CAmount amount;
+        if (!ParseFixedPoint(fields[i + 1], 8, &amount)) {
+            error = strprintf("failed to parse amount: %s", fields[i + 1]);
+            return false;
+        }
+        record.spent_scripts.emplace_back(scriptData.begin(), scriptData.end());
+        record.amounts.push_back(amount);
+    }
+    return true;
+}
+
+bool parse_batch_record(const std::string& line, BatchRecord& record, std::string& error) {
+    CMutableTransaction mtx;
+    if (!parse_batch_record(line, mtx, record, error)) return false;
+    record.tx = MakeTransactionRef(std::move(mtx));
+    record.txdata = std::make_shared<PrecomputedTransactionData>(*record.tx);
+    return true;
+}
+
+/** Number of records whose hashes are computed together (see SHA256DBatch). */
+static const size_t BATCH_HASH_SLICE = 256;
+
+/**
+ * Finish parsing records[begin..end), computing the txids and precomputed
+ * transaction data of all of them at once.
+ */
+static void hash_batch_records(std::vector<CMutableTransaction>& mtxs, std::vector<BatchRecord>& records, const std::vector<char>& parsed, size_t begin, size_t end) {
+    std::vector<size_t> indices;
+    std::vector<std::vector<unsigned char>> data;
+    for (size_t i = begin; i < end; ++i) {
+        if (!parsed[i]) continue;
+        indices.push_back(i);
+        data.emplace_back();
+        CVectorWriter(SER_GETHASH, SERIALIZE_TRANSACTION_NO_WITNESS, data.back(), 0, mtxs[i]);
+    }
+    std::vector<Span<const unsigned char>> spans;
+    for (const auto& d : data) spans.emplace_back(d.data(), d.size());
+    std::vector<unsigned char> hashes(32 * spans.size());
+    SHA256DBatch(hashes.data(), spans.data(), spans.size());
+
+    std::vector<const CTransaction*> txs;
+    std::vector<std::shared_ptr<PrecomputedTransactionData>> txdata;
+    std::vector<PrecomputedTransactionData*> txdata_ptrs;
+    for (size_t k = 0; k < indices.size(); ++k) {
+        BatchRecord& record = records[indices[k]];
+        uint256 hash;
+        memcpy(hash.begin(), &hashes[32 * k], 32);
+        record.tx = std::make_shared<const CTransaction>(std::move(mtxs[indices[k]]), hash);
+        txs.push_back(record.tx.get());
+        txdata.push_back(std::make_shared<PrecomputedTransactionData>());
+        txdata_ptrs.push_back(txdata.back().get());
+    }
+    PrecomputeTransactionDataBatch(txs.data(), txdata_ptrs.data(), txs.size());
+    for (size_t k = 0; k < indices.size(); ++k) {
+        records[indices[k]].txdata = txdata[k];
+    }
+}
+
+ScriptError verify_batch_input(const BatchRecord& record, size_t n, unsigned int flags) {
+    const CTransaction& tx = *record.tx;
+    ScriptError serror = SCRIPT_ERR_UNKNOWN_ERROR;
+    try {
+        VerifyScript(tx.vin[n].scriptSig, record.spent_scripts[n], &tx.vin[n].scriptWitness, flags, TransactionSignatureChecker(&tx, n, record.amounts[n], *record.txdata), &serror);
+    } catch (const std::exception&) {
+        serror = SCRIPT_ERR_UNKNOWN_ERROR;
+    }
+    return serror;
+}
+
+void verify_batch_record(const BatchRecord& record, unsigned int flags, std::vector<ScriptError>& results) {
+    results.resize(record.tx->vin.size());
+    for (size_t i = 0; i < results.size(); ++i) {
+        results[i] = verify_batch_input(record, i, flags);
+    }
+}
+
+BatchStats run_batch(FILE* in, FILE* out, unsigned int flags, size_t threads) {
+    BatchStats stats;
+    WorkStealingPool pool(threads);
+    std::vector<std::string> lines;
+    std::vector<size_t> linenos;
+    std::vector<BatchRecord> records;
+    std::vector<CMutableTransaction> mtxs;
+    std::vector<std::string> errors;
+    std::vector<char> parsed;
+    std::vector<std::vector<ScriptError>> results;
+    std::vector<std::pair<size_t, size_t>> inputs;
+    char* buf = nullptr;
+    size_t cap = 0;
+    size_t lineno = 0;
+    bool eof = false;
+    while (!eof) {
+        lines.clear();
+        linenos.clear();
+        while (lines.size() < BATCH_CHUNK_SIZE) {
+            if (getline(&buf, &cap, in) == -1) {
+                eof = true;
+                break;
+            }
+            ++lineno;
+            const char* p = buf;
+            while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
+            if (!*p || *p == '#') continue;
+            lines.emplace_back(p);
+            linenos.push_back(lineno);
+        }
+
+        // parse every record, then compute txids and precomputed transaction
+        // data a slice at a time, so the hashing can use every SIMD lane
+        records.clear();
+        records.resize(lines.size());
+        mtxs.clear();
+        mtxs.resize(lines.size());
+        errors.assign(lines.size(), "");
+        parsed.assign(lines.size(), 0);
+        pool.run(lines.size(), [&](size_t i) {
+            parsed[i] = parse_batch_record(lines[i], mtxs[i], records[i], errors[i]);
+        });
+        pool.run((lines.size() + BATCH_HASH_SLICE - 1) / BATCH_HASH_SLICE, [&](size_t s) {
+            hash_batch_records(mtxs, records, parsed, s * BATCH_HASH_SLICE, std::min(lines.size(), (s + 1) * BATCH_HASH_SLICE));
+        });
+
+        // verify every input of every record
+        inputs.clear();
+        results.resize(lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (!parsed[i]) continue;
+            results[i].assign(records[i].tx->vin.size(), SCRIPT_ERR_UNKNOWN_ERROR);
+            for (size_t n = 0; n < results[i].size(); ++n) inputs.emplace_back(i, n);
+        }
+        pool.run(inputs.size(), [&](size_t k) {
+            const auto& input = inputs[k];
+            results[input.first][input.second] = verify_batch_input(records[input.first], input.second, flags);
+        });
+
+        // report in input order
+        for (size_t i = 0; i < lines.size(); ++i) {
+            ++stats.records;
+            if (!parsed[i]) {
+                fprintf(stderr, "line %zu: invalid record: %s\n", linenos[i], errors[i].c_str());
+                ++stats.invalid_records;
+                continue;
+            }
+            const std::string txid = records[i].tx->GetHash().ToString();
+            for (size_t n = 0; n < results[i].size(); ++n) {
+                ++stats.inputs;
+                if (results[i][n] == SCRIPT_ERR_OK) {
+                    fprintf(out, "%s:%zu ok\n", txid.c_str(), n);
+                } else {
+                    ++stats.failures;
+                    fprintf(out, "%s:%zu error: %s\n", txid.c_str(), n, ScriptErrorString(results[i][n]));
+                }
+            }
+        }
+    }
+    free(buf);
+    return stats;
+}
+
+struct TxidHasher {
+    size_t operator()(const uint256& txid) const { return txid.GetCheapHash(); }
+};
+
+typedef std::unordered_map<uint256, size_t, TxidHasher> TxOffsetMap;
+
+/**
+ * Fill in the scripts and amounts of the outputs spent by the record's
+ * transaction (found at offset in the file), where they can be found
+ * earlier in the file, setting resolved[n] for each input n which can be
+ * verified.
+ */
+static void resolve_prevouts(const TransactionFileReader& reader, const TxOffsetMap& offsets, size_t offset, BatchRecord& record, std::vector<char>& resolved) {
+    const CTransaction& tx = *record.tx;
+    record.spent_scripts.assign(tx.vin.size(), CScript());
+    record.amounts.assign(tx.vin.size(), 0);
+    resolved.assign(tx.vin.size(), 0);
+    if (tx.IsCoinBase()) return;
+    bool any = false;
+    CTransactionRef prev;
+    for (size_t n = 0; n < tx.vin.size(); ++n) {
+        const COutPoint& prevout = tx.vin[n].prevout;
+        auto it = offsets.find(prevout.hash);
+        // offsets already has the rest of the chunk; only earlier transactions count
+        if (it == offsets.end() || it->second >= offset) continue;
+        // inputs often spend several outputs of the same transaction
+        if (!prev || prev->GetHash() != prevout.hash) {
+            try {
+                prev = reader.read_at(it->second);
+            } catch (const std::exception&) {
+                prev = nullptr;
+                continue;
+            }
+        }
+        if (prevout.n >= prev->vout.size()) continue;
+        record.spent_scripts[n] = prev->vout[prevout.n].scriptPubKey;
+        record.amounts[n] = prev->vout[prevout.n].nValue;
+        resolved[n] = any = true;
+    }
+    if (any) record.txdata = std::make_shared<PrecomputedTransactionData>(tx);
+}
+
+BatchStats run_scan(TransactionFileReader& reader, FILE* out, unsigned int flags, size_t threads) {
+    BatchStats stats;
+    WorkStealingPool pool(threads);
+    TxOffsetMap offsets;
+    std::vector<BatchRecord> records;
+    std::vector<size_t> record_offsets;
+    std::vector<std::vector<char>> resolved;
+    std::vector<std::vector<ScriptError>> results;
+    std::vector<std::pair<size_t, size_t>> inputs;
+    RawTransaction rtx;
+    std::string error;
+    bool more = true;
+    while (more) {
+        records.clear();
+        record_offsets.clear();
+        while (records.size() < BATCH_CHUNK_SIZE) {
+            if (!reader.next(rtx, error)) {
+                more = false;
+                break;
+            }
+            offsets.emplace(rtx.tx->GetHash(), rtx.offset);
+            record_offsets.push_back(rtx.offset);
+            records.emplace_back();
+            records.back().tx = std::move(rtx.tx);
+        }
+
+        // offsets is not modified until the next chunk, so it can be read
+        // from every thread
+        resolved.resize(records.size());
+        pool.run(records.size(), [&](size_t i) {
+            resolve_prevouts(reader, offsets, record_offsets[i], records[i], resolved[i]);
+        });
+
+        inputs.clear();
+        results.resize(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            results[i].assign(records[i].tx->vin.size(), SCRIPT_ERR_UNKNOWN_ERROR);
+            for (size_t n = 0; n < results[i].size(); ++n) {
+                if (resolved[i][n]) inputs.emplace_back(i, n);
+            }
+        }
+        pool.run(inputs.size(), [&](size_t k) {
+            const auto& input = inputs[k];
+            results[input.first][input.second] = verify_batch_input(records[input.first], input.second, flags);
+        });
+
+        // report in input order
+        for (size_t i = 0; i < records.size(); ++i) {
+            ++stats.records;
+            if (records[i].tx->IsCoinBase()) continue;
+            const std::string txid = records[i].tx->GetHash().ToString();
+            for (size_t n = 0; n < results[i].size(); ++n) {
+                if (!resolved[i][n]) {
+                    ++stats.unknown_prevouts;
+                    continue;
+                }
+                ++stats.inputs;
+                if (results[i][n] == SCRIPT_ERR_OK) {
+                    fprintf(out, "%s:%zu ok\n", txid.c_str(), n);
+                } else {
+                    ++stats.failures;
+                    fprintf(out, "%s:%zu error: %s\n", txid.c_str(), n, ScriptErrorString(results[i][n]));
+                }
+            }
+        }
+    }
+    if (!error.empty()) {
+        fprintf(stderr, "error: %s\n", error.c_str());
+        ++stats.invalid_records;
+    }
+    return stats;
+}
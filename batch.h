@@ -0,0 +1,82 @@
+#ifndef included_batch_h_
+#define included_batch_h_
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <amount.h>
+#include <primitives/transaction.h>
+#include <script/interpreter.h>
+
+class TransactionFileReader;
+
+/**
+ * A transaction along with the outputs spent by each of its inputs.
+ *
+ * In the batch input format, each record is a single line of the form
+ *
+ *     <tx hex> <scriptPubKey hex> <amount> [<scriptPubKey hex> <amount> [...]]
+ *
+ * with one scriptPubKey/amount pair per input of the transaction, in input
+ * order. Amounts are given in BTC, as for --tx. Empty lines and lines
+ * starting with # are ignored.
+ */
+struct BatchRecord {
+    CTransactionRef tx;
+    std::shared_ptr<const PrecomputedTransactionData> txdata;
+    std::vector<CScript> spent_scripts;
+    std::vector<CAmount> amounts;
+};
+
+/** Number of records read, and verified in parallel, at a time. */
+static const size_t BATCH_CHUNK_SIZE = 4096;
+
+struct BatchStats {
+    size_t records = 0;
+    size_t inputs = 0;
+    size_t failures = 0;
+    size_t invalid_records = 0;
+    size_t unknown_prevouts = 0; ///< (run_scan) inputs spending outputs not found in the file
+};
+
+bool parse_batch_record(const std::string& line, BatchRecord& record, std::string& error);
+
+/** Verify input n of the record's transaction. Safe to call concurrently. */
+ScriptError verify_batch_input(const BatchRecord& record, size_t n, unsigned int flags);
+
+/**
+ * Verify every input of the record's transaction. The result for input i is
+ * placed in results[i], with SCRIPT_ERR_OK meaning it verified.
+ */
+void verify_batch_record(const BatchRecord& record, unsigned int flags, std::vector<ScriptError>& results);
+
+/**
+ * Read records from in until EOF, writing one line per input to out, either
+ * "<txid>:<n> ok" or "<txid>:<n> error: <reason>". Records that cannot be
+ * parsed are reported on stderr and counted in invalid_records.
+ *
+ * Records are parsed and their inputs verified using the given number of
+ * threads, BATCH_CHUNK_SIZE records at a time. The output is the same
+ * regardless of the number of threads.
+ */
+BatchStats run_batch(FILE* in, FILE* out, unsigned int flags, size_t threads = 1);
+
+/**
+ * Verify the transactions read from reader, BATCH_CHUNK_SIZE at a time,
+ * writing one line per input as run_batch does; each transaction counts as
+ * a record. The outputs spent by an input are looked up among the
+ * transactions before it in the file, which are parsed again out of the
+ * mapping when needed. Inputs spending outputs that are not in the file
+ * cannot be verified, and are counted in unknown_prevouts instead of being
+ * reported; coinbase inputs are skipped.
+ *
+ * Only the offset of each transaction is kept in memory, rather than the
+ * transaction or its outputs, so files far larger than the available memory
+ * can be scanned. If the file turns out to be malformed, this is reported on
+ * stderr and counted as an invalid record, and the scan ends there.
+ */
+BatchStats run_scan(TransactionFileReader& reader, FILE* out, unsigned int flags, size_t threads = 1);
+
+#endif // included_batch_h_
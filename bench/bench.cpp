@@ -0,0 +1,103 @@
+// Copyright (c) 2015-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <tinyformat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include <stdlib.h>
+
+namespace {
+std::atomic<uint64_t> g_allocations{0};
+}
+
+// Count every heap allocation made by the process, so benchmarks can report
+// allocations per iteration alongside their timings.
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+
+namespace benchmark {
+
+uint64_t AllocationCount()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::benchmarks()
+{
+    static BenchmarkMap benchmarks_map;
+    return benchmarks_map;
+}
+
+BenchRunner::BenchRunner(std::string name, BenchFunction func)
+{
+    benchmarks().insert(std::make_pair(name, func));
+}
+
+std::vector<std::string> BenchRunner::List()
+{
+    std::vector<std::string> names;
+    for (const auto& p : benchmarks()) names.push_back(p.first);
+    return names;
+}
+
+std::vector<Result> BenchRunner::RunAll(const std::string& filter, double min_time_ms, int runs)
+{
+    std::vector<Result> results;
+    for (const auto& p : benchmarks()) {
+        if (p.first.find(filter) == std::string::npos) continue;
+
+        // Double the iteration count until a single run takes long enough.
+        uint64_t iterations = 1;
+        for (;;) {
+            State state(iterations);
+            p.second(state);
+            if (state.m_elapsed_ns >= min_time_ms * 1e6 || iterations >= (1ULL << 40)) break;
+            // jump closer to the target, once there is a usable measurement
+            double scale = state.m_elapsed_ns > 1e5 ? min_time_ms * 1e6 / state.m_elapsed_ns * 1.1 : 2;
+            iterations = std::max<uint64_t>(iterations * 2, iterations * std::min(scale, 1e3));
+        }
+
+        std::vector<double> ns, allocs;
+        for (int i = 0; i < runs; ++i) {
+            State state(iterations);
+            p.second(state);
+            ns.push_back(state.m_elapsed_ns / iterations);
+            allocs.push_back((double)state.m_allocations / iterations);
+        }
+        std::sort(ns.begin(), ns.end());
+        std::sort(allocs.begin(), allocs.end());
+        results.push_back({p.first, iterations, ns[ns.size() / 2], allocs[allocs.size() / 2]});
+    }
+    return results;
+}
+
+std::string ToJSON(const std::vector<Result>& results)
+{
+    std::string json = "{\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        json += strprintf("%s\n    {\"name\": \"%s\", \"iterations\": %u, \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f}",
+                          i ? "," : "", r.name, r.iterations, r.ns_per_op, r.allocs_per_op);
+    }
+    json += "\n  ]\n}\n";
+    return json;
+}
+
+} // namespace benchmark
@@ -0,0 +1,108 @@
+// Copyright (c) 2015-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_BENCH_H
+#define BITCOIN_BENCH_BENCH_H
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+// Simple micro-benchmarking framework.
+//
+// Benchmarks are free functions taking a benchmark::State, registered with
+// the BENCHMARK macro:
+//
+// static void CODE_TO_TIME(benchmark::State& state)
+// {
+//     ... do any setup needed...
+//     while (state.KeepRunning()) {
+//        ... do stuff you want to time...
+//     }
+//     ... do any cleanup needed...
+// }
+//
+// BENCHMARK(CODE_TO_TIME);
+//
+// The runner picks the number of iterations so that each run takes at least
+// the requested minimum time, repeats the measurement and reports the median
+// nanoseconds and heap allocations per iteration.
+
+namespace benchmark {
+
+typedef std::chrono::steady_clock clock;
+
+/** Number of heap allocations made through operator new so far. */
+uint64_t AllocationCount();
+
+class State {
+    const uint64_t m_iterations;
+    uint64_t m_count;
+    clock::time_point m_start;
+    uint64_t m_start_allocs;
+
+public:
+    double m_elapsed_ns;     //!< time taken by the timed loop
+    uint64_t m_allocations;  //!< heap allocations made by the timed loop
+
+    explicit State(uint64_t iterations) : m_iterations(iterations), m_count(0), m_start_allocs(0), m_elapsed_ns(0), m_allocations(0) {}
+
+    /** Returns true until the loop has run the requested number of iterations. */
+    bool KeepRunning()
+    {
+        if (m_count == 0) {
+            m_start_allocs = AllocationCount();
+            m_start = clock::now();
+        } else if (m_count == m_iterations) {
+            m_elapsed_ns = std::chrono::duration<double, std::nano>(clock::now() - m_start).count();
+            m_allocations = AllocationCount() - m_start_allocs;
+            return false;
+        }
+        ++m_count;
+        return true;
+    }
+};
+
+typedef void (*BenchFunction)(State&);
+
+struct Result {
+    std::string name;
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+};
+
+class BenchRunner
+{
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& benchmarks();
+
+public:
+    BenchRunner(std::string name, BenchFunction func);
+
+    /** The names of all registered benchmarks, in order. */
+    static std::vector<std::string> List();
+
+    /**
+     * Run every benchmark whose name contains filter. Each one is run
+     * runs times for at least min_time_ms milliseconds.
+     */
+    static std::vector<Result> RunAll(const std::string& filter, double min_time_ms, int runs);
+};
+
+/** Render results as a JSON document, one object per benchmark. */
+std::string ToJSON(const std::vector<Result>& results);
+
+} // namespace benchmark
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCH_CAT_I(a, b) a##b
+#define BENCH_CAT(a, b) BENCH_CAT_I(a, b)
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BENCH_CAT(bench_, BENCH_CAT(__LINE__, n))(#n, n);
+
+#endif // BITCOIN_BENCH_BENCH_H
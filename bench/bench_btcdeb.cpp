@@ -0,0 +1,57 @@
+// Copyright (c) 2015-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <crypto/ripemd160.h>
+#include <crypto/sha256.h>
+#include <debugger/script.h>
+#include <pubkey.h>
+
+#include <cliargs.h>
+
+#include <cstdio>
+
+static const double DEFAULT_MIN_TIME_MS = 200;
+static const int DEFAULT_RUNS = 5;
+
+int main(int argc, char* const* argv)
+{
+    cliargs ca;
+    ca.add_option("help", 'h', no_arg);
+    ca.add_option("list", 'l', no_arg);
+    ca.add_option("filter", 'f', req_arg);
+    ca.add_option("min-time", 't', req_arg);
+    ca.add_option("runs", 'r', req_arg);
+    ca.parse(argc, argv);
+
+    if (ca.m.count('h')) {
+        fprintf(stderr, "Syntax: %s [-l|--list] [-f<name>|--filter=<name>] [-t<ms>|--min-time=<ms>] [-r<n>|--runs=<n>]\n", argv[0]);
+        fprintf(stderr, "Runs the benchmarks whose name contains <name> (all of them, by default), and prints\n");
+        fprintf(stderr, "their median time and heap allocations per operation as JSON. Each benchmark is run\n");
+        fprintf(stderr, "<n> times (default %d), each run taking at least <ms> milliseconds (default %g).\n", DEFAULT_RUNS, DEFAULT_MIN_TIME_MS);
+        return 0;
+    }
+
+    if (ca.m.count('l')) {
+        for (const auto& name : benchmark::BenchRunner::List()) printf("%s\n", name.c_str());
+        return 0;
+    }
+
+    double min_time_ms = ca.m.count('t') ? atof(ca.m['t'].c_str()) : DEFAULT_MIN_TIME_MS;
+    int runs = ca.m.count('r') ? atoi(ca.m['r'].c_str()) : DEFAULT_RUNS;
+    if (min_time_ms < 0 || runs < 1) {
+        fprintf(stderr, "error: invalid --min-time or --runs\n");
+        return 1;
+    }
+
+    btc_logf = btc_logf_dummy;
+    SHA256AutoDetect();
+    RIPEMD160AutoDetect();
+    ECCVerifyHandle evh;
+
+    std::vector<benchmark::Result> results = benchmark::BenchRunner::RunAll(ca.m.count('f') ? ca.m['f'] : "", min_time_ms, runs);
+    printf("%s", benchmark::ToJSON(results).c_str());
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2016-2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <crypto/ripemd160.h>
+#include <crypto/sha256.h>
+#include <hash.h>
+#include <merkle.h>
+#include <uint256.h>
+
+#include <vector>
+
+static void SHA256D64_1024(benchmark::State& state)
+{
+    std::vector<unsigned char> in(64 * 1024, 0);
+    while (state.KeepRunning()) {
+        SHA256D64(in.data(), in.data(), 1024);
+    }
+}
+
+static void SHA256_1M(benchmark::State& state)
+{
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    std::vector<unsigned char> in(1000 * 1000, 0);
+    while (state.KeepRunning()) {
+        CSHA256().Write(in.data(), in.size()).Finalize(hash);
+    }
+}
+
+static void MerkleRoot(benchmark::State& state)
+{
+    std::vector<uint256> leaves(9001);
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        leaves[i] = Hash(leaves[i].begin(), leaves[i].end());
+        leaves[i].begin()[0] = (unsigned char)i;
+        leaves[i].begin()[1] = (unsigned char)(i >> 8);
+    }
+    while (state.KeepRunning()) {
+        bool mutated = false;
+        uint256 root = ComputeMerkleRoot(leaves, &mutated);
+        leaves[mutated ? 1 : 0] = root;
+    }
+}
+
+/** 1024 32-byte messages, as hashed by the RIPEMD-160 step of HASH160. */
+static void RIPEMD160_32_1024(benchmark::State& state)
+{
+    std::vector<unsigned char> in(32 * 1024, 0), out(20 * 1024);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < 1024; ++i) {
+            CRIPEMD160().Write(&in[32 * i], 32).Finalize(&out[20 * i]);
+        }
+    }
+}
+
+static void RIPEMD160Batch32_1024(benchmark::State& state)
+{
+    std::vector<unsigned char> in(32 * 1024, 0), out(20 * 1024);
+    while (state.KeepRunning()) {
+        RIPEMD160Batch32(out.data(), in.data(), 1024);
+    }
+}
+
+/** HASH160 of 1024 compressed public keys, as when deriving P2PKH/P2WPKH addresses. */
+static void HASH160_1024(benchmark::State& state)
+{
+    std::vector<unsigned char> keys(33 * 1024, 0x02);
+    std::vector<uint160> out(1024);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < 1024; ++i) {
+            out[i] = Hash160(&keys[33 * i], &keys[33 * (i + 1)]);
+        }
+    }
+}
+
+static void Hash160Batch_1024(benchmark::State& state)
+{
+    std::vector<unsigned char> keys(33 * 1024, 0x02), out(20 * 1024);
+    std::vector<Span<const unsigned char>> spans;
+    for (size_t i = 0; i < 1024; ++i) spans.emplace_back(&keys[33 * i], 33);
+    while (state.KeepRunning()) {
+        Hash160Batch(out.data(), spans.data(), spans.size());
+    }
+}
+
+BENCHMARK(SHA256D64_1024);
+BENCHMARK(SHA256_1M);
+BENCHMARK(MerkleRoot);
+BENCHMARK(RIPEMD160_32_1024);
+BENCHMARK(RIPEMD160Batch32_1024);
+BENCHMARK(HASH160_1024);
+BENCHMARK(Hash160Batch_1024);
@@ -0,0 +1,249 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <debugger/analyze.h>
+#include <debugger/interpreter.h>
+#include <policy/policy.h>
+#include <primitives/transaction.h>
+#include <pubkey.h>
+#include <script/interpreter.h>
+#include <utilstrencodings.h>
+
+#include <secp256k1.h>
+
+#include <assert.h>
+
+typedef std::vector<unsigned char> valtype;
+
+namespace {
+
+/** Deterministic keys, and a one-in one-out transaction for them to sign. */
+struct SigningFixture {
+    secp256k1_context* ctx;
+    std::vector<std::vector<unsigned char>> seckeys;
+    std::vector<CPubKey> pubkeys;
+    CMutableTransaction mtx;
+    CTransaction tx;
+    PrecomputedTransactionData txdata;
+    CAmount amount;
+
+    static CMutableTransaction MakeTransaction()
+    {
+        CMutableTransaction mtx;
+        mtx.vin.resize(1);
+        mtx.vin[0].prevout = COutPoint(uint256S("9086ce64fce1bb086395faf6fac37c73f32ba4ea89330432bf8ee8035e9315aa"), 1);
+        mtx.vout.resize(1);
+        mtx.vout[0].nValue = 100000;
+        mtx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << valtype(20, 0x42) << OP_EQUALVERIFY << OP_CHECKSIG;
+        return mtx;
+    }
+
+    explicit SigningFixture(size_t keys) : mtx(MakeTransaction()), tx(mtx), txdata(tx), amount(150000)
+    {
+        ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+        for (size_t i = 0; i < keys; ++i) {
+            std::vector<unsigned char> seckey(32, 0);
+            seckey[31] = (unsigned char)(i + 1);
+            secp256k1_pubkey pubkey;
+            bool ok = secp256k1_ec_pubkey_create(ctx, &pubkey, seckey.data());
+            assert(ok);
+            unsigned char ser[33];
+            size_t serlen = sizeof(ser);
+            secp256k1_ec_pubkey_serialize(ctx, ser, &serlen, &pubkey, SECP256K1_EC_COMPRESSED);
+            seckeys.push_back(seckey);
+            pubkeys.emplace_back(ser, ser + serlen);
+        }
+    }
+    ~SigningFixture() { secp256k1_context_destroy(ctx); }
+
+    /** A SIGHASH_ALL signature of the transaction's input by the given key. */
+    valtype Sign(size_t key, const CScript& script, SigVersion sigversion)
+    {
+        uint256 hash = SignatureHash(script, tx, 0, SIGHASH_ALL, amount, sigversion, &txdata);
+        secp256k1_ecdsa_signature sig;
+        bool ok = secp256k1_ecdsa_sign(ctx, &sig, hash.begin(), seckeys[key].data(), nullptr, nullptr);
+        assert(ok);
+        valtype der(72);
+        size_t derlen = der.size();
+        secp256k1_ecdsa_signature_serialize_der(ctx, der.data(), &derlen, &sig);
+        der.resize(derlen);
+        der.push_back(SIGHASH_ALL);
+        return der;
+    }
+};
+
+/** Evaluate script on (a copy of) stack in one go, as the consensus code does. */
+void RunEval(benchmark::State& state, const SigningFixture& f, const std::vector<valtype>& stack, const CScript& script, SigVersion sigversion)
+{
+    TransactionSignatureChecker checker(&f.tx, 0, f.amount, f.txdata);
+    while (state.KeepRunning()) {
+        std::vector<valtype> s(stack);
+        ScriptError serror;
+        bool ok = EvalScript(s, script, STANDARD_SCRIPT_VERIFY_FLAGS, checker, sigversion, &serror);
+        assert(ok);
+    }
+}
+
+/**
+ * Step through script on (a copy of) stack as the debugger does, recording
+ * history unless record_history is false (as when piping).
+ */
+void RunStep(benchmark::State& state, const SigningFixture& f, const std::vector<valtype>& stack, const CScript& script, SigVersion sigversion, bool record_history = true)
+{
+    TransactionSignatureChecker checker(&f.tx, 0, f.amount, f.txdata);
+    while (state.KeepRunning()) {
+        std::vector<valtype> s(stack);
+        ScriptError serror;
+        InterpreterEnv env(s, script, STANDARD_SCRIPT_VERIFY_FLAGS, checker, sigversion, &serror);
+        env.record_history = record_history;
+        bool ok = ContinueScript(env);
+        assert(ok);
+    }
+}
+
+struct P2PKH {
+    SigningFixture f;
+    CScript script;
+    std::vector<valtype> stack;
+    P2PKH() : f(1)
+    {
+        script = CScript() << OP_DUP << OP_HASH160 << ToByteVector(f.pubkeys[0].GetID()) << OP_EQUALVERIFY << OP_CHECKSIG;
+        stack = {f.Sign(0, script, SigVersion::BASE), ToByteVector(f.pubkeys[0])};
+    }
+};
+
+struct Multisig15 {
+    SigningFixture f;
+    CScript script;
+    std::vector<valtype> stack;
+    Multisig15() : f(15)
+    {
+        script << OP_15;
+        for (const CPubKey& pubkey : f.pubkeys) script << ToByteVector(pubkey);
+        script << OP_15 << OP_CHECKMULTISIG;
+        stack.emplace_back();
+        for (size_t i = 0; i < 15; ++i) stack.push_back(f.Sign(i, script, SigVersion::BASE));
+    }
+};
+
+/** A witness script hashing 64 maximum size witness elements. */
+struct LargeWitness {
+    SigningFixture f;
+    CScript script;
+    std::vector<valtype> stack;
+    LargeWitness() : f(0)
+    {
+        for (int i = 0; i < 63; ++i) script << OP_SHA256 << OP_DROP;
+        script << OP_SHA256;
+        for (int i = 0; i < 64; ++i) stack.emplace_back(MAX_SCRIPT_ELEMENT_SIZE, (unsigned char)i);
+    }
+};
+
+/**
+ * A long unexecuted branch at the bottom of 100 nested conditionals, the
+ * deepest the op limit allows.
+ */
+struct NestedIf {
+    SigningFixture f;
+    CScript script;
+    std::vector<valtype> stack;
+    NestedIf() : f(0)
+    {
+        for (int i = 0; i < 99; ++i) script << OP_1 << OP_IF;
+        script << OP_0 << OP_IF;
+        for (int i = 0; i < 5000; ++i) script << OP_1;
+        for (int i = 0; i < 100; ++i) script << OP_ENDIF;
+        script << OP_1;
+    }
+};
+
+} // namespace
+
+static void EvalScriptP2PKH(benchmark::State& state)
+{
+    P2PKH b;
+    RunEval(state, b.f, b.stack, b.script, SigVersion::BASE);
+}
+
+static void StepScriptP2PKH(benchmark::State& state)
+{
+    P2PKH b;
+    RunStep(state, b.f, b.stack, b.script, SigVersion::BASE);
+}
+
+static void EvalScriptMultisig15of15(benchmark::State& state)
+{
+    Multisig15 b;
+    RunEval(state, b.f, b.stack, b.script, SigVersion::BASE);
+}
+
+static void StepScriptMultisig15of15(benchmark::State& state)
+{
+    Multisig15 b;
+    RunStep(state, b.f, b.stack, b.script, SigVersion::BASE);
+}
+
+static void EvalScriptLargeWitness(benchmark::State& state)
+{
+    LargeWitness b;
+    RunEval(state, b.f, b.stack, b.script, SigVersion::WITNESS_V0);
+}
+
+static void StepScriptLargeWitness(benchmark::State& state)
+{
+    LargeWitness b;
+    RunStep(state, b.f, b.stack, b.script, SigVersion::WITNESS_V0);
+}
+
+static void FastStepScriptLargeWitness(benchmark::State& state)
+{
+    LargeWitness b;
+    RunStep(state, b.f, b.stack, b.script, SigVersion::WITNESS_V0, false);
+}
+
+static void EvalScriptNestedIf(benchmark::State& state)
+{
+    NestedIf b;
+    RunEval(state, b.f, b.stack, b.script, SigVersion::BASE);
+}
+
+static void AnalyzeScriptMultisig15of15(benchmark::State& state)
+{
+    Multisig15 b;
+    while (state.KeepRunning()) {
+        ScriptAnalysis a = AnalyzeScript(b.script);
+        assert(a.IsValid());
+    }
+}
+
+static void SignatureHashBase(benchmark::State& state)
+{
+    Multisig15 b;
+    while (state.KeepRunning()) {
+        SignatureHash(b.script, b.f.tx, 0, SIGHASH_ALL, b.f.amount, SigVersion::BASE);
+    }
+}
+
+static void SignatureHashWitnessV0(benchmark::State& state)
+{
+    Multisig15 b;
+    // without precomputed midstates, so the prevout, sequence and output hashes are included
+    while (state.KeepRunning()) {
+        SignatureHash(b.script, b.f.tx, 0, SIGHASH_ALL, b.f.amount, SigVersion::WITNESS_V0);
+    }
+}
+
+BENCHMARK(EvalScriptP2PKH);
+BENCHMARK(StepScriptP2PKH);
+BENCHMARK(EvalScriptMultisig15of15);
+BENCHMARK(StepScriptMultisig15of15);
+BENCHMARK(EvalScriptLargeWitness);
+BENCHMARK(StepScriptLargeWitness);
+BENCHMARK(FastStepScriptLargeWitness);
+BENCHMARK(EvalScriptNestedIf);
+BENCHMARK(AnalyzeScriptMultisig15of15);
+BENCHMARK(SignatureHashBase);
+BENCHMARK(SignatureHashWitnessV0);
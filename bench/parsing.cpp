@@ -0,0 +1,83 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+
+#include <base58.h>
+#include <bech32.h>
+#include <instance.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+#include <utilstrencodings.h>
+#include <value.h>
+
+#include <assert.h>
+
+static void ValueParseArgs(benchmark::State& state)
+{
+    VALUE_WARN = false;
+    static const char* args = "[OP_DUP OP_HASH160 0x1290b657a78e201967c22d8022b348bd5e23ce17 OP_EQUALVERIFY OP_CHECKSIG] "
+                              "0x304402207f874ef00f11dcc9a621acad9354f3fca1bf90c43878f607b7e2d358088487e7022052a01b47b8eef5e1c96a6affdc3dac46fdc11b60612464dc8c5921a852090d2701 "
+                              "0x0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c 1000 -17 \"hello\"";
+    while (state.KeepRunning()) {
+        std::vector<Value> values = Value::parse_args(args);
+        assert(values.size() == 6);
+    }
+}
+
+static void HexRoundTrip(benchmark::State& state)
+{
+    std::vector<unsigned char> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (unsigned char)(i * 7);
+    while (state.KeepRunning()) {
+        std::string hex = HexStr(data);
+        data = ParseHex(hex);
+    }
+}
+
+static void Base58CheckRoundTrip(benchmark::State& state)
+{
+    std::vector<unsigned char> payload = ParseHex("001290b657a78e201967c22d8022b348bd5e23ce17");
+    while (state.KeepRunning()) {
+        std::string encoded = EncodeBase58Check(payload);
+        bool ok = DecodeBase58Check(encoded, payload);
+        assert(ok);
+    }
+}
+
+static void Bech32RoundTrip(benchmark::State& state)
+{
+    // the 5-bit groups of a version 0 witness program, as in a native segwit address
+    std::vector<uint8_t> values(33);
+    for (size_t i = 0; i < values.size(); ++i) values[i] = (uint8_t)((i * 11) & 31);
+    values[0] = 0;
+    while (state.KeepRunning()) {
+        std::string encoded = bech32::Encode("bc", values);
+        auto decoded = bech32::Decode(encoded);
+        assert(decoded.first == "bc");
+        values = std::move(decoded.second);
+    }
+}
+
+/** Parse a transaction with 100 inputs, each with a witness of 10 1 kB items, as --tx does. */
+static void ParseLargeTransaction(benchmark::State& state)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(100);
+    for (CTxIn& in : mtx.vin) in.scriptWitness.stack.assign(10, std::vector<unsigned char>(1000, 0x5a));
+    mtx.vout.resize(1);
+    std::vector<unsigned char> data;
+    CVectorWriter(SER_DISK, 0, data, 0, mtx);
+    std::string hex = HexStr(data);
+    while (state.KeepRunning()) {
+        CTransactionRef tx = parse_tx(hex.c_str());
+        assert(tx && tx->vin.size() == 100);
+    }
+}
+
+BENCHMARK(ValueParseArgs);
+BENCHMARK(HexRoundTrip);
+BENCHMARK(Base58CheckRoundTrip);
+BENCHMARK(Bech32RoundTrip);
+BENCHMARK(ParseLargeTransaction);
@@ -3,6 +3,13 @@
 #include <inttypes.h>
 
 #include <instance.h>
+#include <batch.h>
+#include <trace.h>
+#include <tx_file.h>
+#include <debugger/analyze.h>
+#include <script/sigcache.h>
+#include <crypto/sha256.h>
+#include <crypto/ripemd160.h>
 
 #include <tinyformat.h>
 
@@ -14,12 +21,15 @@ extern "C" {
 
 int fn_step(const char*);
 int fn_rewind(const char*);
+int fn_goto(const char*);
 int fn_exec(const char*);
 int fn_stack(const char*);
 int fn_altstack(const char*);
 int fn_vfexec(const char*);
 int fn_print(const char*);
 int fn_tf(const char*);
+int fn_profile(const char*);
+int fn_analyze(const char*);
 char* compl_exec(const char*, int);
 char* compl_tf(const char*, int);
 int print_stack(std::vector<valtype>&, bool raw = false);
@@ -32,6 +42,19 @@ int count = 0;
 char** script_lines;
 Instance instance;
 InterpreterEnv* env;
+ScriptProfile profile;
+std::unique_ptr<ScriptTraceWriter> trace;
+std::string sigcache_path; // --sigcache-file, if given
+
+/** Print signature cache statistics (unless quiet) and save it, if --sigcache-file was given. */
+void finish_signature_cache() {
+    CSignatureCache* sigcache = GetSignatureCache();
+    if (!sigcache) return;
+    if (!quiet) fprintf(stderr, "signature cache: %" PRIu64 " hits, %" PRIu64 " misses, %zu entries\n", sigcache->Hits(), sigcache->Misses(), sigcache->Size());
+    if (sigcache_path != "" && !sigcache->Save(sigcache_path)) {
+        fprintf(stderr, "warning: unable to save signature cache to %s\n", sigcache_path.c_str());
+    }
+}
 
 struct script_verify_flag {
     std::string str;
@@ -105,6 +128,23 @@ static unsigned int svf_parse_flags(unsigned int in_flags, const char* mod) {
 
 void print_dualstack();
 
+/** How an instruction is shown: its push data in hex, or its name. */
+static std::string instruction_str(const DecodedScript& script, const DecodedScript::Instruction& ins)
+{
+    if (ins.push_size == 0) return GetOpName(ins.opcode);
+    const unsigned char* data = script.PushData(ins);
+    return HexStr(data, data + ins.push_size);
+}
+
+/** The script pushed by the last instruction of script (empty if it is not a push). */
+static CScript last_push_script(const DecodedScript& script)
+{
+    if (script.size() == 0) return CScript();
+    const DecodedScript::Instruction& ins = script[script.size() - 1];
+    const unsigned char* data = script.PushData(ins);
+    return CScript(data, data + ins.push_size);
+}
+
 int main(int argc, char* const* argv)
 {
     pipe_in = !isatty(fileno(stdin)) || std::getenv("DEBUG_SET_PIPE_IN");
@@ -115,32 +155,54 @@ int main(int argc, char* const* argv)
     ca.add_option("help", 'h', no_arg);
     ca.add_option("quiet", 'q', no_arg);
     ca.add_option("tx", 'x', req_arg);
+    ca.add_option("tx-file", 'y', req_arg);
     ca.add_option("txin", 'i', req_arg);
     ca.add_option("modify-flags", 'f', req_arg);
     ca.add_option("select", 's', req_arg);
+    ca.add_option("batch", 'b', req_arg);
+    ca.add_option("jobs", 'j', req_arg);
+    ca.add_option("scan", 'S', req_arg);
+    ca.add_option("sigcache", 'c', no_arg);
+    ca.add_option("sigcache-file", 'C', req_arg);
+    ca.add_option("profile", 'P', opt_arg);
+    ca.add_option("trace", 'T', req_arg);
+    ca.add_option("trace-format", 'F', req_arg);
+    ca.add_option("fast", 'X', no_arg);
     ca.parse(argc, argv);
     quiet = ca.m.count('q') || pipe_in || pipe_out;
 
     if (ca.m.count('h')) {
-        fprintf(stderr, "syntax: %s [-q|--quiet] [--tx=[amount1,amount2,..:]<hex> [--txin=<hex>] [--modify-flags=<flags>|-f<flags>] [--select=<index>|-s<index>] [<script> [<stack bottom item> [... [<stack top item>]]]]]\n", argv[0]);
+        fprintf(stderr, "syntax: %s [-q|--quiet] [--tx=[amount1,amount2,..:]<hex>|--tx-file=[amount1,amount2,..:]<file>] [--txin=<hex>] [--modify-flags=<flags>|-f<flags>] [--select=<index>|-s<index>] [--batch=<file>|-b<file>|--scan=<file>|-S<file> [--jobs=<n>|-j<n>]] [--sigcache|-c] [--sigcache-file=<file>|-C<file>] [--profile[=json]] [--trace=<file> [--trace-format=jsonl|binary]] [--fast|-X] [<script> [<stack bottom item> [... [<stack top item>]]]]]\n", argv[0]);
         fprintf(stderr, "if executed with no arguments, an empty script and empty stack is provided\n");
         fprintf(stderr, "to debug transaction signatures, you need to provide the transaction hex (the WHOLE hex, not just the txid) "
             "as well as (SegWit only) every amount for the inputs\n");
         fprintf(stderr, "e.g. if a SegWit transaction abc123... has 2 inputs of 0.1 btc and 0.002 btc, you would do tx=0.1,0.002:abc123...\n");
         fprintf(stderr, "you do not need the amounts for non-SegWit transactions\n");
+        fprintf(stderr, "to load a large transaction, write it in raw (binary) form to a file and use --tx-file=<file> instead of --tx; amounts are given the same way, e.g. --tx-file=0.1,0.002:tx.bin\n");
         fprintf(stderr, "by providing a txin as well as a tx and no script or stack, btcdeb will attempt to set up a debug session for the verification of the given input by pulling the appropriate values out of the respective transactions. you do not need amounts for --tx in this case\n");
         fprintf(stderr, "you can modify verification flags using the --modify-flags command. separate flags using comma (,). prefix with + to enable, - to disable. e.g. --modify-flags=\"-NULLDUMMY,-MINIMALIF\"\n");
+        fprintf(stderr, "to verify many transactions in one go, use --batch=<file> (or --batch=- for stdin), where each line of the file is a record of the form <tx hex> <scriptPubKey hex> <amount> [<scriptPubKey hex> <amount> ...], with one scriptPubKey and amount (spent by the corresponding input) per input; one result line is printed for every input; use --jobs=<n> to verify using n threads\n");
+        fprintf(stderr, "--scan=<file> verifies the transactions in a block file (blk*.dat) or a file of raw transactions back to back, without reading it all into memory; inputs are verified when the outputs they spend are in the file, and printed as for --batch\n");
+        fprintf(stderr, "--sigcache remembers signatures which have been verified, so that they do not need to be verified again; with --sigcache-file=<file>, the cache is also loaded from and saved to the given file, so it is kept between runs\n");
+        fprintf(stderr, "--profile, when piping, prints the number of times each opcode was executed, the time spent on it, the bytes it pushed and the signature checks it made, after running the script; use --profile=json for JSON output (the `profile` command shows the same in a debug session)\n");
+        fprintf(stderr, "--trace=<file> writes a record of every step taken (the opcode and its position, the items it popped and pushed on the stack and altstack, the vfExec depth and op count) to <file>, one JSON object per line, or in a compact binary form with --trace-format=binary\n");
+        fprintf(stderr, "--fast steps through the script without keeping the history needed to rewind, so that memory use stays constant; this is always done when piping\n");
         fprintf(stderr, "the standard (enabled by default) flags are:\n・ %s\n", svf_string(STANDARD_SCRIPT_VERIFY_FLAGS, "\n・ ").c_str());
         return 1;
     } else if (!quiet) {
         btc_logf("btcdeb -- type `%s -h` for start up options\n", argv[0]);
     }
 
+#ifndef DISABLE_DEBUG_LOGGING
     if (!pipe_in) {
         if (std::getenv("DEBUG_SIGHASH")) btc_sighash_logf = btc_logf_stderr;
         if (std::getenv("DEBUG_SIGNING")) btc_sign_logf = btc_logf_stderr;
         if (std::getenv("DEBUG_SEGWIT"))  btc_segwit_logf = btc_logf_stderr;
     }
+#endif
+
+    SHA256AutoDetect();
+    RIPEMD160AutoDetect();
 
     unsigned int flags = STANDARD_SCRIPT_VERIFY_FLAGS;
     if (ca.m.count('f')) {
@@ -148,6 +210,50 @@ int main(int argc, char* const* argv)
         if (!quiet) fprintf(stderr, "resulting flags:\n・ %s\n", svf_string(flags, "\n・ ").c_str());
     }
 
+    if (ca.m.count('c') || ca.m.count('C')) {
+        InitSignatureCache();
+        if (ca.m.count('C')) sigcache_path = ca.m['C'];
+        if (sigcache_path != "" && !GetSignatureCache()->Load(sigcache_path)) {
+            if (!quiet) fprintf(stderr, "note: starting with an empty signature cache (unable to load %s)\n", sigcache_path.c_str());
+        }
+    }
+
+    if (ca.m.count('b') || ca.m.count('S')) {
+        int jobs = ca.m.count('j') ? atoi(ca.m['j'].c_str()) : 1;
+        if (jobs < 1) {
+            fprintf(stderr, "error: invalid number of jobs: %s\n", ca.m['j'].c_str());
+            return 1;
+        }
+        btc_logf = btc_logf_dummy;
+        BatchStats stats;
+        if (ca.m.count('S')) {
+            TransactionFileReader reader;
+            std::string error;
+            if (!reader.open(ca.m['S'], error)) {
+                fprintf(stderr, "error: %s\n", error.c_str());
+                return 1;
+            }
+            stats = run_scan(reader, stdout, flags, jobs);
+            if (!quiet || stats.failures || stats.invalid_records) {
+                fprintf(stderr, "%zu transactions, %zu inputs: %zu verified, %zu failed, %zu spending outputs not in the file\n", stats.records, stats.inputs + stats.unknown_prevouts, stats.inputs - stats.failures, stats.failures, stats.unknown_prevouts);
+            }
+        } else {
+            const std::string& path = ca.m['b'];
+            FILE* fp = path == "-" ? stdin : fopen(path.c_str(), "r");
+            if (!fp) {
+                fprintf(stderr, "error: unable to open %s for reading\n", path.c_str());
+                return 1;
+            }
+            stats = run_batch(fp, stdout, flags, jobs);
+            if (fp != stdin) fclose(fp);
+            if (!quiet || stats.failures || stats.invalid_records) {
+                fprintf(stderr, "%zu records, %zu inputs: %zu verified, %zu failed, %zu invalid records\n", stats.records, stats.inputs, stats.inputs - stats.failures, stats.failures, stats.invalid_records);
+            }
+        }
+        finish_signature_cache();
+        return stats.failures || stats.invalid_records ? 1 : 0;
+    }
+
     int selected = -1;
     if (ca.m.count('s')) {
         selected = atoi(ca.m['s'].c_str());
@@ -159,9 +265,14 @@ int main(int argc, char* const* argv)
         ca.l.erase(ca.l.begin(), ca.l.begin() + 1);
     }
 
+    if (ca.m.count('x') && ca.m.count('y')) {
+        fprintf(stderr, "error: --tx and --tx-file cannot be used together\n");
+        return 1;
+    }
+
     // crude check for tx=
-    if (ca.m.count('x')) {
-        if (!instance.parse_transaction(ca.m['x'].c_str(), true)) {
+    if (ca.m.count('x') || ca.m.count('y')) {
+        if (ca.m.count('x') ? !instance.parse_transaction(ca.m['x'].c_str(), true) : !instance.load_transaction_file(ca.m['y'].c_str())) {
             return 1;
         }
         if (!quiet) fprintf(stderr, "got %stransaction %s:\n%s\n", instance.sigver == SigVersion::WITNESS_V0 ? "segwit " : "", instance.tx->GetHash().ToString().c_str(), instance.tx->ToString().c_str());
@@ -208,16 +319,34 @@ int main(int argc, char* const* argv)
     }
 
     env = instance.env;
+    env->record_history = !(pipe_in || pipe_out || ca.m.count('X'));
+    bool profiling = !(pipe_in || pipe_out) || ca.m.count('P');
+    if (profiling) env->profile = &profile;
+    if (ca.m.count('T')) {
+        TraceFormat format = TraceFormat::JSONL;
+        if (ca.m.count('F') && ca.m['F'] == "binary") {
+            format = TraceFormat::BINARY;
+        } else if (ca.m.count('F') && ca.m['F'] != "jsonl") {
+            fprintf(stderr, "error: unknown trace format %s (use jsonl or binary)\n", ca.m['F'].c_str());
+            return 1;
+        }
+        FILE* file = fopen(ca.m['T'].c_str(), format == TraceFormat::BINARY ? "wb" : "w");
+        if (!file) {
+            fprintf(stderr, "error: unable to open %s for writing\n", ca.m['T'].c_str());
+            return 1;
+        }
+        trace.reset(new ScriptTraceWriter(file, format));
+        env->tracer = trace.get();
+    }
 
-    std::vector<CScript*> script_ptrs;
+    std::vector<const DecodedScript*> scripts;
     std::vector<std::string> script_headers;
+    DecodedScript successor_decoded, p2sh_decoded;
 
-    script_ptrs.push_back(&env->script);
+    env->decoded.Decode(env->script);
+    scripts.push_back(&env->decoded);
     script_headers.push_back("");
-    CScriptIter it = env->script.begin();
-    opcodetype opcode;
-    valtype vchPushValue, p2sh_script_payload;
-    while (env->script.GetOp(it, opcode, vchPushValue)) { p2sh_script_payload = vchPushValue; ++count; }
+    count += env->decoded.size();
 
     CScript p2sh_script;
     bool has_p2sh = false;
@@ -227,46 +356,43 @@ int main(int argc, char* const* argv)
         p2sh_script = CScript(p2sh_script_val.begin(), p2sh_script_val.end());
     }
     if (instance.successor_script.size()) {
-        script_ptrs.push_back(&instance.successor_script);
+        successor_decoded.Decode(instance.successor_script);
+        scripts.push_back(&successor_decoded);
         script_headers.push_back("<<< scriptPubKey >>>");
-        count++;
-        it = instance.successor_script.begin();
-        while (instance.successor_script.GetOp(it, opcode, vchPushValue)) ++count;
+        count += 1 + successor_decoded.size();
         if ((env->flags & SCRIPT_VERIFY_P2SH) && instance.successor_script.IsPayToScriptHash()) {
             has_p2sh = true;
-            p2sh_script = CScript(p2sh_script_payload.begin(), p2sh_script_payload.end());
+            p2sh_script = last_push_script(env->decoded);
         }
     }
     if (has_p2sh) {
-        script_ptrs.push_back(&p2sh_script);
+        p2sh_decoded.Decode(p2sh_script);
+        scripts.push_back(&p2sh_decoded);
         script_headers.push_back("<<< P2SH script >>>");
-        count++;
-        it = p2sh_script.begin();
-        while (p2sh_script.GetOp(it, opcode, vchPushValue)) ++count;
+        count += 1 + p2sh_decoded.size();
     }
     script_lines = (char**)malloc(sizeof(char*) * count);
 
     int i = 0;
-    char buf[1024];
-    for (size_t siter = 0; siter < script_ptrs.size(); ++siter) {
-        CScript* script = script_ptrs[siter];
+    for (size_t siter = 0; siter < scripts.size(); ++siter) {
+        const DecodedScript& script = *scripts[siter];
         const std::string& header = script_headers[siter];
         if (header != "") script_lines[i++] = strdup(header.c_str());
-        it = script->begin();
-        while (script->GetOp(it, opcode, vchPushValue)) {
-            char* pbuf = buf;
-            pbuf += sprintf(pbuf, "#%04d ", i);
-            if (vchPushValue.size() > 0) {
-                sprintf(pbuf, "%s", HexStr(vchPushValue.begin(), vchPushValue.end()).c_str());
-            } else {
-                sprintf(pbuf, "%s", GetOpName(opcode));
-            }
-            script_lines[i++] = strdup(buf);
+        for (size_t j = 0; j < script.size(); ++j) {
+            script_lines[i] = strdup(strprintf("#%04d %s", i, instruction_str(script, script[j])).c_str());
+            ++i;
         }
     }
 
     if (pipe_in || pipe_out) {
-        if (!ContinueScript(*env)) {
+        bool success = ContinueScript(*env);
+        finish_signature_cache();
+        if (trace && !trace->close()) {
+            fprintf(stderr, "error: failed to write trace to %s\n", ca.m['T'].c_str());
+            return 1;
+        }
+        if (profiling) fprintf(stderr, "%s", ca.m['P'] == "json" ? profile.ToJSON().c_str() : profile.ToString().c_str());
+        if (!success) {
             fprintf(stderr, "error: %s\n", ScriptErrorString(*env->serror));
             print_dualstack();
             return 1;
@@ -281,6 +407,7 @@ int main(int argc, char* const* argv)
         kerl_set_comment_char('#');
         kerl_register("step", fn_step, "Execute one instruction and iterate in the script.");
         kerl_register("rewind", fn_rewind, "Go back in time one instruction.");
+        kerl_register("goto", fn_goto, "Go to the given instruction (by #) in the script.");
         kerl_register("stack", fn_stack, "Print stack content.");
         kerl_register("altstack", fn_altstack, "Print altstack content.");
         kerl_register("vfexec", fn_vfexec, "Print vfexec content.");
@@ -289,6 +416,8 @@ int main(int argc, char* const* argv)
         kerl_set_completor("exec", compl_exec);
         kerl_set_completor("tf", compl_tf);
         kerl_register("print", fn_print, "Print script.");
+        kerl_register("analyze", fn_analyze, "Print stack and resource bounds of the current script, worked out without running it.");
+        kerl_register("profile", fn_profile, "Print per-opcode execution statistics (profile json for JSON, profile reset to clear).");
         kerl_register_help("help");
         if (!quiet) btc_logf("%d op script loaded. type `help` for usage information\n", count);
         print_dualstack();
@@ -296,6 +425,7 @@ int main(int argc, char* const* argv)
             printf("%s\n", script_lines[env->curr_op_seq]);
         }
         kerl_run("btcdeb> ");
+        finish_signature_cache();
     }
 }
 
@@ -312,6 +442,7 @@ int fn_step(const char* arg) {
 }
 
 int fn_rewind(const char* arg) {
+    if (!env->record_history) fail("error: history is not kept with --fast\n");
     if (instance.at_start()) fail("error: no history to rewind\n");
     if (!instance.rewind()) fail("error: failed to rewind; this is a bug\n");
     print_dualstack();
@@ -321,50 +452,70 @@ int fn_rewind(const char* arg) {
     return 0;
 }
 
-inline void svprintscripts(std::vector<std::string>& l, int& lmax, std::vector<CScript*>& scripts, std::vector<std::string>& headers, CScriptIter it) {
-    char buf[1024];
-    opcodetype opcode;
-    valtype vchPushValue;
+int fn_goto(const char* arg) {
+    char* endptr;
+    long op_seq = strtol(arg, &endptr, 10);
+    if (endptr == arg || op_seq < 0 || op_seq > count) fail("syntax: goto <op> (0-%d)\n", count);
+    if (!env->record_history && op_seq < env->curr_op_seq) fail("error: history is not kept with --fast, so only forward jumps are possible\n");
+    if (!instance.seek(op_seq)) fail("error: unable to reach #%04ld: %s\n", op_seq, instance.error_string().c_str());
+    print_dualstack();
+    if (env->curr_op_seq < count) {
+        printf("%s\n", script_lines[env->curr_op_seq]);
+    }
+    return 0;
+}
+
+inline void svprintscripts(std::vector<std::string>& l, int& lmax, const std::vector<const DecodedScript*>& scripts, std::vector<std::string>& headers, size_t offset) {
     bool begun = false;
     for (size_t siter = 0; siter < scripts.size(); ++siter) {
-        CScript* script = scripts[siter];
+        const DecodedScript& script = *scripts[siter];
+        size_t i = 0;
 
         if (begun) {
             if (headers[siter] != "") {
                 if (headers[siter].length() > lmax) lmax = headers[siter].length();
                 l.push_back(headers[siter]);
             }
-            it = script->begin();
+        } else {
+            i = script.Find(offset);
         }
 
-        while (script->GetOp(it, opcode, vchPushValue)) {
+        for (; i < script.size(); ++i) {
             begun = true;
-            char* pbuf = buf;
-            if (vchPushValue.size() > 0) {
-                sprintf(pbuf, "%s", HexStr(vchPushValue.begin(), vchPushValue.end()).c_str());
-            } else {
-                sprintf(pbuf, "%s", GetOpName(opcode));
-            }
-            auto s = std::string(buf);
+            auto s = instruction_str(script, script[i]);
             if (s.length() > lmax) lmax = s.length();
             l.push_back(s);
         }
 
-        if (it == script->end()) begun = true;
+        if (script.Complete()) begun = true;
     }
 }
 
+/** The decoding of a script shown next to the stack, redone only when the script changes. */
+struct decoded_script_cache {
+    CScript script;
+    DecodedScript decoded;
+    const DecodedScript& get(const CScript& s) {
+        if (!decoded.IsFor(script) || s != script) {
+            script = s;
+            decoded.Decode(script);
+        }
+        return decoded;
+    }
+};
+
 void print_dualstack() {
     // generate lines for left and right hand side (stack vs script)
-    auto it = env->pc;
     std::vector<std::string> l, r;
     static int glmax = 7;
     static int grmax = 7;
     int lmax = 0;
     int rmax = 0;
-    std::vector<CScript*> scripts;
+    static decoded_script_cache successor_cache, p2sh_cache;
+    std::vector<const DecodedScript*> scripts;
     std::vector<std::string> headers;
-    scripts.push_back(&env->script);
+    if (!env->decoded.IsFor(env->script)) env->decoded.Decode(env->script);
+    scripts.push_back(&env->decoded);
     headers.push_back("");
     CScript p2sh_script;
     bool has_p2sh = false;
@@ -374,22 +525,18 @@ void print_dualstack() {
         p2sh_script = CScript(p2sh_script_val.begin(), p2sh_script_val.end());
     }
     if (env->successor_script.size()) {
-        scripts.push_back(&env->successor_script);
+        scripts.push_back(&successor_cache.get(env->successor_script));
         headers.push_back("<<< scriptPubKey >>>");
         if ((env->flags & SCRIPT_VERIFY_P2SH) && env->successor_script.IsPayToScriptHash()) {
             has_p2sh = true;
-            CScriptIter it = env->script.begin();
-            opcodetype opcode;
-            valtype vchPushValue, p2sh_script_payload;
-            while (env->script.GetOp(it, opcode, vchPushValue)) { p2sh_script_payload = vchPushValue; }
-            p2sh_script = CScript(p2sh_script_payload.begin(), p2sh_script_payload.end());
+            p2sh_script = last_push_script(env->decoded);
         }
     }
     if (has_p2sh) {
-        scripts.push_back(&p2sh_script);
+        scripts.push_back(&p2sh_cache.get(p2sh_script));
         headers.push_back("<<< P2SH script >>>");
     }
-    svprintscripts(l, lmax, scripts, headers, it);
+    svprintscripts(l, lmax, scripts, headers, env->pc - env->script.begin());
 
     for (int j = env->stack.size() - 1; j >= 0; j--) {
         auto& it = env->stack[j];
@@ -468,7 +615,7 @@ int fn_altstack(const char*) {
 }
 
 int fn_vfexec(const char*) {
-    return print_bool_stack(env->vfExec);
+    return print_bool_stack(env->vfExec.values());
 }
 
 static const char* tfs[] = {
@@ -679,6 +826,22 @@ int fn_print(const char*) {
     return 0;
 }
 
+int fn_profile(const char* arg) {
+    if (!strcmp(arg, "reset")) {
+        profile.Reset();
+        return 0;
+    }
+    if (strcmp(arg, "") && strcmp(arg, "json")) fail("syntax: profile [json|reset]\n");
+    if (profile.Empty()) fail("nothing has been executed yet\n");
+    printf("%s", strcmp(arg, "json") ? profile.ToString().c_str() : profile.ToJSON().c_str());
+    return 0;
+}
+
+int fn_analyze(const char* arg) {
+    printf("%s", AnalyzeScript(env->script).ToString().c_str());
+    return 0;
+}
+
 static const char* opnames[] = {
     // push value
     "OP_0",
@@ -2,12 +2,33 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <crypto/ripemd160.h>
 
 #include <crypto/common.h>
 
+#include <assert.h>
 #include <string.h>
 
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#if defined(ENABLE_SSE41)
+namespace ripemd160_sse41
+{
+void Transform_4way_32(unsigned char* out, const unsigned char* in);
+}
+#endif
+
+#if defined(ENABLE_AVX2)
+namespace ripemd160_avx2
+{
+void Transform_8way_32(unsigned char* out, const unsigned char* in);
+}
+#endif
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -233,10 +254,86 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[4] = t + b1 + c2;
 }
 
+/** Compute the RIPEMD-160 of a single 32-byte message. */
+void Transform_32(unsigned char* out, const unsigned char* in)
+{
+    uint32_t s[5];
+    unsigned char block[64] = {0};
+    memcpy(block, in, 32);
+    block[32] = 0x80;
+    WriteLE64(block + 56, 256);
+    Initialize(s);
+    Transform(s, block);
+    for (int i = 0; i < 5; ++i) WriteLE32(out + 4 * i, s[i]);
+}
+
 } // namespace ripemd160
 
+typedef void (*Transform32Type)(unsigned char*, const unsigned char*);
+
+Transform32Type Transform_4way_32 = nullptr;
+Transform32Type Transform_8way_32 = nullptr;
+
+bool SelfTest()
+{
+    // Eight arbitrary 32-byte messages, checked against the generic implementation.
+    unsigned char in[8 * 32];
+    for (int i = 0; i < 8 * 32; ++i) in[i] = (unsigned char)(i * 17 + 3);
+    unsigned char expected[8 * 20];
+    for (int i = 0; i < 8; ++i) CRIPEMD160().Write(in + 32 * i, 32).Finalize(expected + 20 * i);
+
+    unsigned char out[8 * 20];
+    ripemd160::Transform_32(out, in);
+    if (memcmp(out, expected, 20)) return false;
+    if (Transform_4way_32) {
+        Transform_4way_32(out, in);
+        if (memcmp(out, expected, 4 * 20)) return false;
+    }
+    if (Transform_8way_32) {
+        Transform_8way_32(out, in);
+        if (memcmp(out, expected, 8 * 20)) return false;
+    }
+    return true;
+}
+
 } // namespace
 
+std::string RIPEMD160AutoDetect()
+{
+    std::string ret = "standard";
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    uint32_t max_leaf = eax;
+    cpuid(1, 0, eax, ebx, ecx, edx);
+    bool have_sse41 = (ecx >> 19) & 1;
+    bool enabled_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1) && AVXEnabled();
+    bool have_avx2 = false;
+    if (max_leaf >= 7) {
+        cpuid(7, 0, eax, ebx, ecx, edx);
+        have_avx2 = (ebx >> 5) & 1;
+    }
+    (void)have_sse41;
+    (void)enabled_avx;
+    (void)have_avx2;
+#if defined(ENABLE_SSE41)
+    if (have_sse41) {
+        Transform_4way_32 = ripemd160_sse41::Transform_4way_32;
+        ret += ",sse41(4way)";
+    }
+#endif
+#if defined(ENABLE_AVX2)
+    if (have_avx2 && enabled_avx) {
+        Transform_8way_32 = ripemd160_avx2::Transform_8way_32;
+        ret += ",avx2(8way)";
+    }
+#endif
+#endif
+
+    assert(SelfTest());
+    return ret;
+}
+
 ////// RIPEMD160
 
 CRIPEMD160::CRIPEMD160() : bytes(0)
@@ -290,3 +387,29 @@ CRIPEMD160& CRIPEMD160::Reset()
     ripemd160::Initialize(s);
     return *this;
 }
+
+void RIPEMD160Batch32(unsigned char* out, const unsigned char* in, size_t count)
+{
+    if (Transform_8way_32) {
+        while (count >= 8) {
+            Transform_8way_32(out, in);
+            out += 160;
+            in += 256;
+            count -= 8;
+        }
+    }
+    if (Transform_4way_32) {
+        while (count >= 4) {
+            Transform_4way_32(out, in);
+            out += 80;
+            in += 128;
+            count -= 4;
+        }
+    }
+    while (count) {
+        ripemd160::Transform_32(out, in);
+        out += 20;
+        in += 32;
+        --count;
+    }
+}
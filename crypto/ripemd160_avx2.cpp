@@ -0,0 +1,130 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_AVX2
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace ripemd160_avx2 {
+namespace {
+
+// message word, rotation and constant for each round, of the left and right lines
+const int RL[80] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+    7, 4, 13, 1, 10, 6, 15, 3, 12, 0, 9, 5, 2, 14, 11, 8,
+    3, 10, 14, 4, 9, 15, 8, 1, 2, 7, 0, 6, 13, 11, 5, 12,
+    1, 9, 11, 10, 0, 8, 12, 4, 13, 3, 7, 15, 14, 5, 6, 2,
+    4, 0, 5, 9, 7, 12, 2, 10, 14, 1, 3, 8, 11, 6, 15, 13,
+};
+const int RR[80] = {
+    5, 14, 7, 0, 9, 2, 11, 4, 13, 6, 15, 8, 1, 10, 3, 12,
+    6, 11, 3, 7, 0, 13, 5, 10, 14, 15, 8, 12, 4, 9, 1, 2,
+    15, 5, 1, 3, 7, 14, 6, 9, 11, 8, 12, 2, 10, 0, 4, 13,
+    8, 6, 4, 1, 3, 11, 15, 0, 5, 12, 2, 13, 9, 7, 10, 14,
+    12, 15, 10, 4, 1, 5, 8, 7, 6, 2, 13, 14, 0, 3, 9, 11,
+};
+const int SL[80] = {
+    11, 14, 15, 12, 5, 8, 7, 9, 11, 13, 14, 15, 6, 7, 9, 8,
+    7, 6, 8, 13, 11, 9, 7, 15, 7, 12, 15, 9, 11, 7, 13, 12,
+    11, 13, 6, 7, 14, 9, 13, 15, 14, 8, 13, 6, 5, 12, 7, 5,
+    11, 12, 14, 15, 14, 15, 9, 8, 9, 14, 5, 6, 8, 6, 5, 12,
+    9, 15, 5, 11, 6, 8, 13, 12, 5, 12, 13, 14, 11, 8, 5, 6,
+};
+const int SR[80] = {
+    8, 9, 9, 11, 13, 15, 15, 5, 7, 7, 8, 11, 14, 14, 12, 6,
+    9, 13, 15, 7, 12, 8, 9, 11, 7, 7, 12, 7, 6, 15, 13, 11,
+    9, 7, 15, 11, 8, 6, 6, 14, 12, 13, 5, 14, 13, 13, 7, 5,
+    15, 5, 8, 11, 14, 14, 6, 14, 6, 9, 12, 9, 12, 5, 15, 8,
+    8, 5, 12, 9, 12, 5, 14, 6, 8, 13, 6, 5, 15, 13, 11, 11,
+};
+const uint32_t KL[5] = {0, 0x5A827999ul, 0x6ED9EBA1ul, 0x8F1BBCDCul, 0xA953FD4Eul};
+const uint32_t KR[5] = {0x50A28BE6ul, 0x5C4DD124ul, 0x6D703EF3ul, 0x7A6D76E9ul, 0};
+
+const uint32_t INIT[5] = {0x67452301ul, 0xEFCDAB89ul, 0x98BADCFEul, 0x10325476ul, 0xC3D2E1F0ul};
+
+__m256i inline Set(uint32_t x) { return _mm256_set1_epi32(x); }
+__m256i inline Add(__m256i x, __m256i y) { return _mm256_add_epi32(x, y); }
+__m256i inline Xor(__m256i x, __m256i y) { return _mm256_xor_si256(x, y); }
+__m256i inline Or(__m256i x, __m256i y) { return _mm256_or_si256(x, y); }
+__m256i inline And(__m256i x, __m256i y) { return _mm256_and_si256(x, y); }
+__m256i inline AndNot(__m256i x, __m256i y) { return _mm256_andnot_si256(x, y); } // ~x & y
+__m256i inline Not(__m256i x) { return Xor(x, _mm256_set1_epi32(-1)); }
+__m256i inline Rol(__m256i x, int n) { return Or(_mm256_sll_epi32(x, _mm_cvtsi32_si128(n)), _mm256_srl_epi32(x, _mm_cvtsi32_si128(32 - n))); }
+
+__m256i inline f1(__m256i x, __m256i y, __m256i z) { return Xor(Xor(x, y), z); }
+__m256i inline f2(__m256i x, __m256i y, __m256i z) { return Or(And(x, y), AndNot(x, z)); }
+__m256i inline f3(__m256i x, __m256i y, __m256i z) { return Xor(Or(x, Not(y)), z); }
+__m256i inline f4(__m256i x, __m256i y, __m256i z) { return Or(And(x, z), AndNot(z, y)); }
+__m256i inline f5(__m256i x, __m256i y, __m256i z) { return Xor(x, Or(y, Not(z))); }
+
+__m256i inline F(int j, __m256i x, __m256i y, __m256i z)
+{
+    switch (j) {
+    case 0: return f1(x, y, z);
+    case 1: return f2(x, y, z);
+    case 2: return f3(x, y, z);
+    case 3: return f4(x, y, z);
+    default: return f5(x, y, z);
+    }
+}
+
+/** Perform a RIPEMD-160 transformation of one block in each lane. */
+void inline Transform(__m256i* s, const __m256i* w)
+{
+    __m256i al = s[0], bl = s[1], cl = s[2], dl = s[3], el = s[4];
+    __m256i ar = al, br = bl, cr = cl, dr = dl, er = el;
+    for (int j = 0; j < 80; ++j) {
+        __m256i t = Add(Rol(Add(Add(al, F(j / 16, bl, cl, dl)), Add(w[RL[j]], Set(KL[j / 16]))), SL[j]), el);
+        al = el; el = dl; dl = Rol(cl, 10); cl = bl; bl = t;
+        t = Add(Rol(Add(Add(ar, F(4 - j / 16, br, cr, dr)), Add(w[RR[j]], Set(KR[j / 16]))), SR[j]), er);
+        ar = er; er = dr; dr = Rol(cr, 10); cr = br; br = t;
+    }
+    __m256i t = s[0];
+    s[0] = Add(Add(s[1], cl), dr);
+    s[1] = Add(Add(s[2], dl), er);
+    s[2] = Add(Add(s[3], el), ar);
+    s[3] = Add(Add(s[4], al), br);
+    s[4] = Add(Add(t, bl), cr);
+}
+
+__m256i inline Read8(const unsigned char* in, int offset) {
+    return _mm256_setr_epi32(
+        ReadLE32(in + offset), ReadLE32(in + 32 + offset), ReadLE32(in + 64 + offset), ReadLE32(in + 96 + offset),
+        ReadLE32(in + 128 + offset), ReadLE32(in + 160 + offset), ReadLE32(in + 192 + offset), ReadLE32(in + 224 + offset));
+}
+
+void inline Write8(unsigned char* out, int offset, __m256i v) {
+    WriteLE32(out + offset, _mm256_extract_epi32(v, 0));
+    WriteLE32(out + 20 + offset, _mm256_extract_epi32(v, 1));
+    WriteLE32(out + 40 + offset, _mm256_extract_epi32(v, 2));
+    WriteLE32(out + 60 + offset, _mm256_extract_epi32(v, 3));
+    WriteLE32(out + 80 + offset, _mm256_extract_epi32(v, 4));
+    WriteLE32(out + 100 + offset, _mm256_extract_epi32(v, 5));
+    WriteLE32(out + 120 + offset, _mm256_extract_epi32(v, 6));
+    WriteLE32(out + 140 + offset, _mm256_extract_epi32(v, 7));
+}
+
+}
+
+/** Compute the RIPEMD-160 of eight 32-byte messages (e.g. the SHA256 step of HASH160) at once. */
+void Transform_8way_32(unsigned char* out, const unsigned char* in)
+{
+    __m256i s[5], w[16];
+    for (int i = 0; i < 5; ++i) s[i] = Set(INIT[i]);
+    for (int i = 0; i < 8; ++i) w[i] = Read8(in, 4 * i);
+    // padding: 0x80, zeroes, and the message length in bits
+    w[8] = Set(0x80);
+    for (int i = 9; i < 14; ++i) w[i] = Set(0);
+    w[14] = Set(256);
+    w[15] = Set(0);
+    Transform(s, w);
+    for (int i = 0; i < 5; ++i) Write8(out, 4 * i, s[i]);
+}
+
+}
+
+#endif
@@ -2,6 +2,10 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <crypto/sha256.h>
 #include <crypto/common.h>
 
@@ -9,25 +13,30 @@
 #include <string.h>
 #include <atomic>
 
-#if defined(__x86_64__) || defined(__amd64__)
-#if defined(USE_ASM)
-#include <cpuid.h>
-namespace sha256_sse4
+#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+#if defined(ENABLE_SHANI)
+namespace sha256_shani
 {
 void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
 }
 #endif
-#endif
 
+#if defined(ENABLE_SSE41)
 namespace sha256d64_sse41
 {
 void Transform_4way(unsigned char* out, const unsigned char* in);
+void TransformMulti_4way(uint32_t* const* s, const unsigned char* const* chunk);
 }
+#endif
 
+#if defined(ENABLE_AVX2)
 namespace sha256d64_avx2
 {
 void Transform_8way(unsigned char* out, const unsigned char* in);
+void TransformMulti_8way(uint32_t* const* s, const unsigned char* const* chunk);
 }
+#endif
+#endif
 
 // Internal implementation code.
 namespace
@@ -406,6 +415,7 @@ void TransformD64(unsigned char* out, const unsigned char* in)
 
 typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
 typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+typedef void (*TransformMultiType)(uint32_t* const*, const unsigned char* const*);
 
 template<TransformType tr>
 void TransformD64Wrapper(unsigned char* out, const unsigned char* in)
@@ -450,6 +460,8 @@ TransformType Transform = sha256::Transform;
 TransformD64Type TransformD64 = sha256::TransformD64;
 TransformD64Type TransformD64_4way = nullptr;
 TransformD64Type TransformD64_8way = nullptr;
+TransformMultiType TransformMulti = nullptr;
+size_t TransformMultiLanes = 1;
 
 bool SelfTest() {
     // Input state (equal to the initial SHA256 state)
@@ -526,17 +538,24 @@ bool SelfTest() {
         if (!std::equal(out, out + 256, result_d64)) return false;
     }
 
-    return true;
-}
-
+    // Test TransformMulti, if available, with each lane at a different point in the input.
+    if (TransformMulti) {
+        uint32_t states[8][8];
+        uint32_t* lanes[8];
+        const unsigned char* chunks[8];
+        for (size_t i = 0; i < TransformMultiLanes; ++i) {
+            std::copy(result[i], result[i] + 8, states[i]);
+            lanes[i] = states[i];
+            chunks[i] = data + 1 + 64 * i;
+        }
+        TransformMulti(lanes, chunks);
+        for (size_t i = 0; i < TransformMultiLanes; ++i) {
+            if (!std::equal(states[i], states[i] + 8, result[i + 1])) return false;
+        }
+    }
 
-#if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
-// We can't use cpuid.h's __get_cpuid as it does not support subleafs.
-void inline cpuid(uint32_t leaf, uint32_t subleaf, uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
-{
-  __asm__ ("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "0"(leaf), "2"(subleaf));
+    return true;
 }
-#endif
 } // namespace
 
 
@@ -544,27 +563,58 @@ std::string SHA256AutoDetect()
 {
     std::string ret = "standard";
 #if defined(USE_ASM) && (defined(__x86_64__) || defined(__amd64__) || defined(__i386__))
+    bool have_sse41 = false;
+    bool have_xsave = false;
+    bool have_avx = false;
+    bool have_avx2 = false;
+    bool have_shani = false;
+    bool enabled_avx = false;
+
+    (void)have_sse41;
+    (void)have_avx2;
+    (void)have_shani;
+
     uint32_t eax, ebx, ecx, edx;
+    cpuid(0, 0, eax, ebx, ecx, edx);
+    uint32_t max_leaf = eax;
     cpuid(1, 0, eax, ebx, ecx, edx);
-    if ((ecx >> 19) & 1) {
-#if defined(__x86_64__) || defined(__amd64__)
-        Transform = sha256_sse4::Transform;
-        TransformD64 = TransformD64Wrapper<sha256_sse4::Transform>;
-#endif
-#if defined(ENABLE_SSE41) && !defined(BUILD_BITCOIN_INTERNAL)
-        TransformD64_4way = sha256d64_sse41::Transform_4way;
-        ret = "sse4(1way+4way)";
-#if defined(ENABLE_AVX2) && !defined(BUILD_BITCOIN_INTERNAL)
+    have_sse41 = (ecx >> 19) & 1;
+    have_xsave = (ecx >> 27) & 1;
+    have_avx = (ecx >> 28) & 1;
+    if (have_xsave && have_avx) {
+        enabled_avx = AVXEnabled();
+    }
+    if (max_leaf >= 7) {
         cpuid(7, 0, eax, ebx, ecx, edx);
-        if ((ebx >> 5) & 1) {
-            TransformD64_8way = sha256d64_avx2::Transform_8way;
-            ret += ",avx2(8way)";
-        }
+        have_avx2 = (ebx >> 5) & 1;
+        have_shani = (ebx >> 29) & 1;
+    }
+
+    // SHA-NI is the fastest for single hashes, but the wide SIMD kernels still
+    // win for hashing many 64-byte blobs at once, so use both where available.
+#if defined(ENABLE_SHANI)
+    if (have_shani && have_sse41) {
+        Transform = sha256_shani::Transform;
+        TransformD64 = TransformD64Wrapper<sha256_shani::Transform>;
+        ret = "shani(1way)";
+    }
 #endif
-#else
-        ret = "sse4";
+#if defined(ENABLE_SSE41)
+    if (have_sse41) {
+        TransformD64_4way = sha256d64_sse41::Transform_4way;
+        TransformMulti = sha256d64_sse41::TransformMulti_4way;
+        TransformMultiLanes = 4;
+        ret += ",sse41(4way)";
+    }
 #endif
+#if defined(ENABLE_AVX2)
+    if (have_avx2 && have_avx && enabled_avx) {
+        TransformD64_8way = sha256d64_avx2::Transform_8way;
+        TransformMulti = sha256d64_avx2::TransformMulti_8way;
+        TransformMultiLanes = 8;
+        ret += ",avx2(8way)";
     }
+#endif
 #endif
 
     assert(SelfTest());
@@ -628,6 +678,60 @@ CSHA256& CSHA256::Reset()
     return *this;
 }
 
+////// SHA256D
+
+void CSHA256D::WriteBlocks(const unsigned char* data, size_t len)
+{
+    const unsigned char* end = data + len;
+    if (bufsize) {
+        // Complete the buffered block, and process it.
+        memcpy(buf + bufsize, data, 64 - bufsize);
+        data += 64 - bufsize;
+        Transform(s, buf, 1);
+        ++blocks;
+    }
+    if (end - data >= 64) {
+        size_t n = (end - data) / 64;
+        Transform(s, data, n);
+        data += 64 * n;
+        blocks += n;
+    }
+    bufsize = end - data;
+    if (bufsize) memcpy(buf, data, bufsize);
+}
+
+void CSHA256D::Finalize(unsigned char hash[OUTPUT_SIZE])
+{
+    uint64_t bits = (blocks * 64 + bufsize) << 3;
+    buf[bufsize++] = 0x80;
+    if (bufsize > 56) {
+        memset(buf + bufsize, 0, 64 - bufsize);
+        Transform(s, buf, 1);
+        bufsize = 0;
+    }
+    memset(buf + bufsize, 0, 56 - bufsize);
+    WriteBE64(buf + 56, bits);
+    Transform(s, buf, 1);
+
+    // The 32 byte digest and its padding make up exactly one block.
+    unsigned char block[64];
+    for (int i = 0; i < 8; ++i) WriteBE32(block + 4 * i, s[i]);
+    block[32] = 0x80;
+    memset(block + 33, 0, 23);
+    WriteBE64(block + 56, 256);
+    sha256::Initialize(s);
+    Transform(s, block, 1);
+    for (int i = 0; i < 8; ++i) WriteBE32(hash + 4 * i, s[i]);
+}
+
+CSHA256D& CSHA256D::Reset()
+{
+    bufsize = 0;
+    blocks = 0;
+    sha256::Initialize(s);
+    return *this;
+}
+
 void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
 {
     if (TransformD64_8way) {
@@ -653,3 +757,122 @@ void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
         --blocks;
     }
 }
+
+namespace
+{
+/** A message being hashed in one lane of a multi-buffer transform. */
+struct Lane
+{
+    size_t index;              //!< which input this is
+    const unsigned char* data; //!< the message
+    size_t full;               //!< number of full blocks in the message
+    size_t blocks;             //!< total number of blocks, including padding
+    size_t block;              //!< next block to compress
+    bool second;               //!< hashing the first hash (double SHA256 only)
+    uint32_t s[8];
+    unsigned char tail[128];   //!< the last partial block of the message, plus padding
+    unsigned char hash[32];    //!< the first hash (double SHA256 only)
+
+    void Start(const unsigned char* in, size_t len)
+    {
+        data = in;
+        full = len / 64;
+        size_t rem = len % 64;
+        blocks = full + (rem + 9 > 64 ? 2 : 1);
+        block = 0;
+        if (rem) memcpy(tail, in + 64 * full, rem);
+        memset(tail + rem, 0, 128 - rem);
+        tail[rem] = 0x80;
+        WriteBE64(tail + 64 * (blocks - full) - 8, (uint64_t)len << 3);
+        sha256::Initialize(s);
+    }
+
+    const unsigned char* Block() const { return block < full ? data + 64 * block : tail + 64 * (block - full); }
+
+    void Finish(unsigned char* out) const
+    {
+        for (int i = 0; i < 8; ++i) WriteBE32(out + 4 * i, s[i]);
+    }
+};
+
+void SHA256BatchImpl(unsigned char* output, const Span<const unsigned char>* inputs, size_t count, bool twice)
+{
+    if (!TransformMulti) {
+        for (size_t i = 0; i < count; ++i) {
+            unsigned char* out = output + 32 * i;
+            CSHA256().Write(inputs[i].data(), inputs[i].size()).Finalize(out);
+            if (twice) CSHA256().Write(out, 32).Finalize(out);
+        }
+        return;
+    }
+
+    const size_t lanes = TransformMultiLanes;
+    Lane lane[8];
+    bool active[8] = {false};
+    size_t next = 0;
+    size_t running = 0;
+    uint32_t* states[8];
+    const unsigned char* chunks[8];
+    for (;;) {
+        // Give every idle lane the next message.
+        for (size_t l = 0; l < lanes && next < count; ++l) {
+            if (active[l]) continue;
+            lane[l].index = next;
+            lane[l].second = false;
+            lane[l].Start(inputs[next].data(), inputs[next].size());
+            active[l] = true;
+            ++running;
+            ++next;
+        }
+        if (!running) break;
+        if (running < lanes) {
+            // Out of messages to fill the lanes with; finish the rest one at a time.
+            for (size_t l = 0; l < lanes; ++l) {
+                if (!active[l]) continue;
+                Lane& ln = lane[l];
+                for (;;) {
+                    Transform(ln.s, ln.Block(), 1);
+                    if (++ln.block < ln.blocks) continue;
+                    if (twice && !ln.second) {
+                        ln.Finish(ln.hash);
+                        ln.second = true;
+                        ln.Start(ln.hash, 32);
+                        continue;
+                    }
+                    ln.Finish(output + 32 * ln.index);
+                    break;
+                }
+            }
+            break;
+        }
+        for (size_t l = 0; l < lanes; ++l) {
+            states[l] = lane[l].s;
+            chunks[l] = lane[l].Block();
+        }
+        TransformMulti(states, chunks);
+        for (size_t l = 0; l < lanes; ++l) {
+            Lane& ln = lane[l];
+            if (++ln.block < ln.blocks) continue;
+            if (twice && !ln.second) {
+                ln.Finish(ln.hash);
+                ln.second = true;
+                ln.Start(ln.hash, 32);
+                continue;
+            }
+            ln.Finish(output + 32 * ln.index);
+            active[l] = false;
+            --running;
+        }
+    }
+}
+} // namespace
+
+void SHA256Batch(unsigned char* output, const Span<const unsigned char>* inputs, size_t count)
+{
+    SHA256BatchImpl(output, inputs, count, false);
+}
+
+void SHA256DBatch(unsigned char* output, const Span<const unsigned char>* inputs, size_t count)
+{
+    SHA256BatchImpl(output, inputs, count, true);
+}
@@ -5,8 +5,11 @@
 #ifndef BITCOIN_CRYPTO_SHA256_H
 #define BITCOIN_CRYPTO_SHA256_H
 
+#include <span.h>
+
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <string>
 
 /** A hasher class for SHA-256. */
@@ -26,6 +29,39 @@ public:
     CSHA256& Reset();
 };
 
+/** A double-SHA256 hasher for streams of small writes, such as serialization.
+ *  Writes that do not complete a block are gathered inline, whole blocks of larger
+ *  writes are compressed straight from the caller's memory, and the second hash is
+ *  a single fixed-size block built in place.
+ */
+class CSHA256D
+{
+private:
+    uint32_t s[8];
+    unsigned char buf[64];
+    size_t bufsize;
+    uint64_t blocks;
+
+    void WriteBlocks(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    CSHA256D() { Reset(); }
+    CSHA256D& Write(const unsigned char* data, size_t len)
+    {
+        if (len < 64 && bufsize + len < 64) {
+            if (len) memcpy(buf + bufsize, data, len);
+            bufsize += len;
+        } else {
+            WriteBlocks(data, len);
+        }
+        return *this;
+    }
+    void Finalize(unsigned char hash[OUTPUT_SIZE]);
+    CSHA256D& Reset();
+};
+
 /** Autodetect the best available SHA256 implementation.
  *  Returns the name of the implementation.
  */
@@ -38,4 +74,16 @@ std::string SHA256AutoDetect();
  */
 void SHA256D64(unsigned char* output, const unsigned char* input, size_t blocks);
 
+/** Compute the SHA256's of multiple independent messages of any length.
+ *  Where available, the messages are interleaved over the lanes of a SIMD
+ *  transform, so this is faster than hashing them one by one.
+ *  output:  pointer to a count*32 byte output buffer
+ *  inputs:  pointer to count messages
+ *  count:   the number of messages.
+ */
+void SHA256Batch(unsigned char* output, const Span<const unsigned char>* inputs, size_t count);
+
+/** As SHA256Batch, but computing double-SHA256's (as for txids and signature hashes). */
+void SHA256DBatch(unsigned char* output, const Span<const unsigned char>* inputs, size_t count);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
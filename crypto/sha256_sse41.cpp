@@ -0,0 +1,145 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifdef ENABLE_SSE41
+
+#include <stdint.h>
+#include <immintrin.h>
+
+#include <crypto/common.h>
+
+namespace sha256d64_sse41 {
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98ul, 0x71374491ul, 0xb5c0fbcful, 0xe9b5dba5ul, 0x3956c25bul, 0x59f111f1ul, 0x923f82a4ul, 0xab1c5ed5ul,
+    0xd807aa98ul, 0x12835b01ul, 0x243185beul, 0x550c7dc3ul, 0x72be5d74ul, 0x80deb1feul, 0x9bdc06a7ul, 0xc19bf174ul,
+    0xe49b69c1ul, 0xefbe4786ul, 0x0fc19dc6ul, 0x240ca1ccul, 0x2de92c6ful, 0x4a7484aaul, 0x5cb0a9dcul, 0x76f988daul,
+    0x983e5152ul, 0xa831c66dul, 0xb00327c8ul, 0xbf597fc7ul, 0xc6e00bf3ul, 0xd5a79147ul, 0x06ca6351ul, 0x14292967ul,
+    0x27b70a85ul, 0x2e1b2138ul, 0x4d2c6dfcul, 0x53380d13ul, 0x650a7354ul, 0x766a0abbul, 0x81c2c92eul, 0x92722c85ul,
+    0xa2bfe8a1ul, 0xa81a664bul, 0xc24b8b70ul, 0xc76c51a3ul, 0xd192e819ul, 0xd6990624ul, 0xf40e3585ul, 0x106aa070ul,
+    0x19a4c116ul, 0x1e376c08ul, 0x2748774cul, 0x34b0bcb5ul, 0x391c0cb3ul, 0x4ed8aa4aul, 0x5b9cca4ful, 0x682e6ff3ul,
+    0x748f82eeul, 0x78a5636ful, 0x84c87814ul, 0x8cc70208ul, 0x90befffaul, 0xa4506cebul, 0xbef9a3f7ul, 0xc67178f2ul,
+};
+
+const uint32_t INIT[8] = {
+    0x6a09e667ul, 0xbb67ae85ul, 0x3c6ef372ul, 0xa54ff53aul, 0x510e527ful, 0x9b05688cul, 0x1f83d9abul, 0x5be0cd19ul,
+};
+
+__m128i inline Set(uint32_t x) { return _mm_set1_epi32(x); }
+__m128i inline Add(__m128i x, __m128i y) { return _mm_add_epi32(x, y); }
+__m128i inline Add(__m128i x, __m128i y, __m128i z) { return Add(Add(x, y), z); }
+__m128i inline Add(__m128i x, __m128i y, __m128i z, __m128i w) { return Add(Add(x, y), Add(z, w)); }
+__m128i inline Xor(__m128i x, __m128i y) { return _mm_xor_si128(x, y); }
+__m128i inline Xor(__m128i x, __m128i y, __m128i z) { return Xor(Xor(x, y), z); }
+__m128i inline Or(__m128i x, __m128i y) { return _mm_or_si128(x, y); }
+__m128i inline And(__m128i x, __m128i y) { return _mm_and_si128(x, y); }
+__m128i inline ShR(__m128i x, int n) { return _mm_srli_epi32(x, n); }
+__m128i inline ShL(__m128i x, int n) { return _mm_slli_epi32(x, n); }
+__m128i inline Rot(__m128i x, int n) { return Or(ShR(x, n), ShL(x, 32 - n)); }
+
+__m128i inline Ch(__m128i x, __m128i y, __m128i z) { return Xor(z, And(x, Xor(y, z))); }
+__m128i inline Maj(__m128i x, __m128i y, __m128i z) { return Or(And(x, y), And(z, Or(x, y))); }
+__m128i inline Sigma0(__m128i x) { return Xor(Rot(x, 2), Rot(x, 13), Rot(x, 22)); }
+__m128i inline Sigma1(__m128i x) { return Xor(Rot(x, 6), Rot(x, 11), Rot(x, 25)); }
+__m128i inline sigma0(__m128i x) { return Xor(Rot(x, 7), Rot(x, 18), ShR(x, 3)); }
+__m128i inline sigma1(__m128i x) { return Xor(Rot(x, 17), Rot(x, 19), ShR(x, 10)); }
+
+/** Run the 64 rounds, given the (K + W) value for each of them. */
+template <typename KW>
+void inline Compress(__m128i* s, KW kw)
+{
+    __m128i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; ++i) {
+        __m128i t1 = Add(h, Sigma1(e), Ch(e, f, g), kw(i));
+        __m128i t2 = Add(Sigma0(a), Maj(a, b, c));
+        h = g; g = f; f = e; e = Add(d, t1);
+        d = c; c = b; b = a; a = Add(t1, t2);
+    }
+    s[0] = Add(s[0], a); s[1] = Add(s[1], b); s[2] = Add(s[2], c); s[3] = Add(s[3], d);
+    s[4] = Add(s[4], e); s[5] = Add(s[5], f); s[6] = Add(s[6], g); s[7] = Add(s[7], h);
+}
+
+/** Compress one block of message words, expanding the message schedule in place. */
+void inline CompressBlock(__m128i* s, __m128i* w)
+{
+    Compress(s, [w](int i) {
+        if (i >= 16) {
+            w[i & 15] = Add(w[i & 15], sigma1(w[(i + 14) & 15]), w[(i + 9) & 15], sigma0(w[(i + 1) & 15]));
+        }
+        return Add(Set(K[i]), w[i & 15]);
+    });
+}
+
+/** The (K + W) values of the padding block following a 64 byte message; the same for every message. */
+struct PaddingSchedule {
+    uint32_t kw[64];
+    PaddingSchedule() {
+        uint32_t w[64] = {0x80000000ul, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x200};
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = (w[i - 15] >> 7 | w[i - 15] << 25) ^ (w[i - 15] >> 18 | w[i - 15] << 14) ^ (w[i - 15] >> 3);
+            uint32_t s1 = (w[i - 2] >> 17 | w[i - 2] << 15) ^ (w[i - 2] >> 19 | w[i - 2] << 13) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for (int i = 0; i < 64; ++i) kw[i] = K[i] + w[i];
+    }
+};
+
+const PaddingSchedule padding;
+
+__m128i inline Read4(const unsigned char* chunk, int offset) {
+    return _mm_setr_epi32(ReadBE32(chunk + offset), ReadBE32(chunk + 64 + offset), ReadBE32(chunk + 128 + offset), ReadBE32(chunk + 192 + offset));
+}
+
+void inline Write4(unsigned char* out, int offset, __m128i v) {
+    WriteBE32(out + offset, _mm_extract_epi32(v, 0));
+    WriteBE32(out + 32 + offset, _mm_extract_epi32(v, 1));
+    WriteBE32(out + 64 + offset, _mm_extract_epi32(v, 2));
+    WriteBE32(out + 96 + offset, _mm_extract_epi32(v, 3));
+}
+
+}
+
+/** Compute the double-SHA256 of four 64-byte messages at once. */
+void Transform_4way(unsigned char* out, const unsigned char* in)
+{
+    __m128i s[8], w[16];
+
+    // Hash the message itself.
+    for (int i = 0; i < 8; ++i) s[i] = Set(INIT[i]);
+    for (int i = 0; i < 16; ++i) w[i] = Read4(in, 4 * i);
+    CompressBlock(s, w);
+
+    // Then its padding.
+    Compress(s, [](int i) { return Set(padding.kw[i]); });
+
+    // Hash the 32 byte result.
+    for (int i = 0; i < 8; ++i) w[i] = s[i];
+    w[8] = Set(0x80000000ul);
+    for (int i = 9; i < 15; ++i) w[i] = Set(0);
+    w[15] = Set(0x100);
+    for (int i = 0; i < 8; ++i) s[i] = Set(INIT[i]);
+    CompressBlock(s, w);
+
+    for (int i = 0; i < 8; ++i) Write4(out, 4 * i, s[i]);
+}
+
+/** Run one compression for each of 4 independent states, each on its own 64-byte block. */
+void TransformMulti_4way(uint32_t* const* s, const unsigned char* const* chunk)
+{
+    __m128i v[8], w[16];
+    for (int i = 0; i < 8; ++i) v[i] = _mm_setr_epi32(s[0][i], s[1][i], s[2][i], s[3][i]);
+    for (int i = 0; i < 16; ++i) w[i] = _mm_setr_epi32(ReadBE32(chunk[0] + 4 * i), ReadBE32(chunk[1] + 4 * i), ReadBE32(chunk[2] + 4 * i), ReadBE32(chunk[3] + 4 * i));
+    CompressBlock(v, w);
+    for (int i = 0; i < 8; ++i) {
+        s[0][i] = _mm_extract_epi32(v[i], 0);
+        s[1][i] = _mm_extract_epi32(v[i], 1);
+        s[2][i] = _mm_extract_epi32(v[i], 2);
+        s[3][i] = _mm_extract_epi32(v[i], 3);
+    }
+}
+
+}
+
+#endif
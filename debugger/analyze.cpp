@@ -0,0 +1,289 @@
+// Copyright (c) 2018 Karl-Johan Alm
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <debugger/analyze.h>
+
+#include <debugger/script.h>
+#include <script/interpreter.h>
+#include <tinyformat.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+
+/** What is known about the stacks along the paths that reach an instruction. */
+struct AbstractState {
+    bool live;           //!< whether any of the paths can still succeed
+    size_t paths;
+    int lo, hi;          //!< stack depth, relative to the initial stack
+    int alt_lo, alt_hi;  //!< altstack depth
+    int need;            //!< initial stack items used so far
+    unsigned int extra_ops; //!< op count added by CHECKMULTISIG key counts
+    AbstractState() : live(true), paths(1), lo(0), hi(0), alt_lo(0), alt_hi(0), need(0), extra_ops(0) {}
+};
+
+AbstractState Join(const AbstractState& a, const AbstractState& b)
+{
+    if (!a.live) return b;
+    if (!b.live) return a;
+    AbstractState r;
+    r.paths = a.paths > std::numeric_limits<size_t>::max() - b.paths ? std::numeric_limits<size_t>::max() : a.paths + b.paths;
+    r.lo = std::min(a.lo, b.lo);
+    r.hi = std::max(a.hi, b.hi);
+    r.alt_lo = std::min(a.alt_lo, b.alt_lo);
+    r.alt_hi = std::max(a.alt_hi, b.alt_hi);
+    r.need = std::max(a.need, b.need);
+    r.extra_ops = std::max(a.extra_ops, b.extra_ops);
+    return r;
+}
+
+/** An IF whose ENDIF has not been reached, with a state for each outcome of the condition. */
+struct Branch {
+    AbstractState taken[2];
+    int active;
+};
+
+/** The value of the small number pushed by the instruction at index, if it is one. */
+bool GetConstant(const DecodedScript& decoded, size_t index, int& value)
+{
+    const DecodedScript::Instruction& ins = decoded[index];
+    if (ins.opcode == OP_0 || ins.opcode == OP_1NEGATE || (ins.opcode >= OP_1 && ins.opcode <= OP_16)) {
+        value = ins.opcode == OP_1NEGATE ? -1 : CScript::DecodeOP_N(ins.opcode);
+        return true;
+    }
+    if (ins.opcode > OP_PUSHDATA4 || ins.push_size > CScriptNum::nDefaultMaxNumSize) return false;
+    const unsigned char* data = decoded.PushData(ins);
+    value = CScriptNum(std::vector<unsigned char>(data, data + ins.push_size), false).getint();
+    return true;
+}
+
+/** Largest element the instruction can push, other than copies of existing ones. */
+size_t ResultSize(const DecodedScript::Instruction& ins)
+{
+    opcodetype opcode = ins.opcode;
+    if (opcode <= OP_PUSHDATA4) return ins.push_size;
+    if (opcode == OP_1NEGATE || (opcode >= OP_1 && opcode <= OP_16)) return 1;
+    switch (opcode) {
+    case OP_RIPEMD160:
+    case OP_SHA1:
+    case OP_HASH160:
+        return 20;
+    case OP_SHA256:
+    case OP_HASH256:
+        return 32;
+    case OP_DEPTH: // at most MAX_STACK_SIZE
+    case OP_SIZE:  // at most MAX_SCRIPT_ELEMENT_SIZE
+        return 2;
+    case OP_EQUAL:
+    case OP_CHECKSIG:
+    case OP_CHECKMULTISIG:
+        return 1;
+    default:
+        // arithmetic on 4 byte numbers gives at most 5 bytes
+        return opcode >= OP_1ADD && opcode <= OP_WITHIN ? 5 : 0;
+    }
+}
+
+} // namespace
+
+ScriptAnalysis AnalyzeScript(const CScript& script)
+{
+    ScriptAnalysis a;
+    a.error = SCRIPT_ERR_OK;
+    a.paths = 1;
+    a.inputs = 0;
+    a.min_depth = a.max_depth = 0;
+    a.peak_depth = a.peak_altdepth = 0;
+    a.max_element_size = 0;
+    a.sigops = script.GetSigOpCount(true);
+    a.max_op_count = 0;
+    a.dynamic = false;
+
+    DecodedScript decoded(script);
+    AbstractState cur;
+    std::vector<Branch> branches;
+    unsigned int ops = 0, max_extra_ops = 0;
+    ScriptError failure = SCRIPT_ERR_OK; // why the last path to fail did so
+
+    for (size_t i = 0; i < decoded.size() && a.error == SCRIPT_ERR_OK; ++i) {
+        const DecodedScript::Instruction& ins = decoded[i];
+        opcodetype opcode = ins.opcode;
+        const OpcodeInfo& info = GetOpcodeInfo(opcode);
+
+        // Failures below happen whether the instruction is executed or not
+        if (ins.push_size > MAX_SCRIPT_ELEMENT_SIZE) {
+            a.error = SCRIPT_ERR_PUSH_SIZE;
+            break;
+        }
+        if (info.counted && ++ops > MAX_OPS_PER_SCRIPT) {
+            a.error = SCRIPT_ERR_OP_COUNT;
+            break;
+        }
+        if (info.disabled) {
+            a.error = SCRIPT_ERR_DISABLED_OPCODE;
+            break;
+        }
+
+        if (info.conditional) {
+            switch (opcode) {
+            case OP_IF:
+            case OP_NOTIF:
+                if (cur.live) {
+                    // the condition
+                    cur.need = std::max(cur.need, 1 - cur.lo);
+                    --cur.lo;
+                    --cur.hi;
+                }
+                branches.push_back(Branch{{cur, cur}, 0});
+                break;
+            case OP_ELSE:
+            case OP_ENDIF: {
+                if (branches.empty()) {
+                    a.error = SCRIPT_ERR_UNBALANCED_CONDITIONAL;
+                    break;
+                }
+                Branch& b = branches.back();
+                b.taken[b.active] = cur;
+                if (opcode == OP_ELSE) {
+                    b.active ^= 1;
+                    cur = b.taken[b.active];
+                } else {
+                    cur = Join(b.taken[0], b.taken[1]);
+                    branches.pop_back();
+                }
+                break;
+            }
+            default:
+                // OP_VERIF, OP_VERNOTIF
+                a.error = SCRIPT_ERR_BAD_OPCODE;
+            }
+            continue;
+        }
+
+        if (!cur.live) continue;
+
+        // Stack effect: pops_min..pops_max items popped, pushes_min..pushes_max
+        // pushed, with at least requires items on the stack beforehand
+        int pops_min, pops_max, pushes_min, pushes_max, requires = 0;
+        pops_min = pops_max = info.slays;
+        pushes_min = pushes_max = info.spawns;
+        switch (opcode) {
+        case OP_RETURN:
+            cur.live = false;
+            failure = SCRIPT_ERR_OP_RETURN;
+            continue;
+        case OP_RESERVED:
+        case OP_VER:
+        case OP_RESERVED1:
+        case OP_RESERVED2:
+            cur.live = false;
+            failure = SCRIPT_ERR_BAD_OPCODE;
+            continue;
+        case OP_PICK:
+        case OP_ROLL: {
+            int n;
+            // the index, and for OP_ROLL the item moved to the top
+            pops_min = pops_max = opcode == OP_PICK ? 1 : 2;
+            pushes_min = pushes_max = 1;
+            requires = 2;
+            if (i > 0 && GetConstant(decoded, i - 1, n)) {
+                // the index and the n + 1 items under it must fit in
+                // MAX_STACK_SIZE; checked before adding to avoid overflow
+                if (n < 0 || n > MAX_STACK_SIZE - 2) {
+                    cur.live = false;
+                    failure = SCRIPT_ERR_INVALID_STACK_OPERATION;
+                    continue;
+                }
+                requires = n + 2;
+            } else {
+                a.dynamic = true;
+            }
+            break;
+        }
+        case OP_IFDUP:
+            pops_min = pops_max = 1;
+            pushes_min = 1;
+            pushes_max = 2;
+            break;
+        case OP_TOALTSTACK:
+            ++cur.alt_lo;
+            ++cur.alt_hi;
+            a.peak_altdepth = std::max(a.peak_altdepth, cur.alt_hi);
+            break;
+        case OP_FROMALTSTACK:
+            if (cur.alt_hi < 1) {
+                cur.live = false;
+                failure = SCRIPT_ERR_INVALID_ALTSTACK_OPERATION;
+                continue;
+            }
+            // paths with an empty altstack fail here
+            cur.alt_lo = std::max(cur.alt_lo - 1, 0);
+            --cur.alt_hi;
+            break;
+        case OP_CHECKMULTISIG:
+        case OP_CHECKMULTISIGVERIFY: {
+            // as in GetSigOpCount, the key count is known if a small number
+            // is pushed right before; the signature count is known if a
+            // small number is pushed right before the keys
+            int keys = -1, sigs = -1;
+            if (i > 0 && decoded[i - 1].opcode >= OP_1 && decoded[i - 1].opcode <= OP_16) {
+                keys = CScript::DecodeOP_N(decoded[i - 1].opcode);
+                if (i >= (size_t)keys + 2 && GetConstant(decoded, i - keys - 2, sigs) && (sigs < 0 || sigs > keys)) sigs = -1;
+            }
+            int max_keys = keys < 0 ? MAX_PUBKEYS_PER_MULTISIG : keys;
+            // the count(s), the keys, the signatures and the dummy element
+            pops_min = 3 + (keys < 0 ? 0 : keys) + (sigs < 0 ? 0 : sigs);
+            pops_max = 3 + max_keys + (sigs < 0 ? max_keys : sigs);
+            pushes_min = pushes_max = opcode == OP_CHECKMULTISIG ? 1 : 0;
+            cur.extra_ops += max_keys;
+            max_extra_ops = std::max(max_extra_ops, cur.extra_ops);
+            break;
+        }
+        default:
+            if (opcode > OP_NOP10) {
+                cur.live = false;
+                failure = SCRIPT_ERR_BAD_OPCODE;
+                continue;
+            }
+        }
+
+        requires = std::max(requires, pops_max);
+        cur.need = std::max(cur.need, requires - cur.lo);
+        cur.lo += pushes_min - pops_max;
+        cur.hi += pushes_max - pops_min;
+        a.peak_depth = std::max(a.peak_depth, cur.hi);
+        a.max_element_size = std::max(a.max_element_size, ResultSize(ins));
+    }
+
+    if (a.error == SCRIPT_ERR_OK && !decoded.Complete()) a.error = SCRIPT_ERR_BAD_OPCODE;
+    if (a.error == SCRIPT_ERR_OK && !branches.empty()) a.error = SCRIPT_ERR_UNBALANCED_CONDITIONAL;
+    if (a.error == SCRIPT_ERR_OK && !cur.live) a.error = failure;
+
+    a.max_op_count = ops + max_extra_ops;
+    if (cur.live) {
+        a.paths = cur.paths;
+        a.inputs = cur.need;
+        a.min_depth = cur.lo;
+        a.max_depth = cur.hi;
+    } else {
+        a.paths = 0;
+    }
+    return a;
+}
+
+std::string ScriptAnalysis::ToString() const
+{
+    std::string ret;
+    if (!IsValid()) ret += strprintf("fails: %s\n", ScriptErrorString(error));
+    ret += strprintf("paths:            %u\n", paths);
+    ret += strprintf("inputs:           %u%s\n", inputs, dynamic ? " (or more, depending on OP_PICK/OP_ROLL arguments)" : "");
+    ret += strprintf("depth change:     %d .. %d\n", min_depth, max_depth);
+    ret += strprintf("peak depth:       %d (altstack %d)\n", peak_depth, peak_altdepth);
+    ret += strprintf("max element size: %u\n", max_element_size);
+    ret += strprintf("sigops:           %u\n", sigops);
+    ret += strprintf("max op count:     %u\n", max_op_count);
+    return ret;
+}
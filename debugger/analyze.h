@@ -0,0 +1,56 @@
+// Copyright (c) 2018 Karl-Johan Alm
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BTCDEB_ANALYZE_H
+#define BITCOIN_BTCDEB_ANALYZE_H
+
+#include <script/script.h>
+#include <script/script_error.h>
+
+#include <string>
+
+/**
+ * Bounds on what running a script can do, worked out from the script
+ * alone: nothing is executed and no signatures are checked. Each IF/ELSE
+ * is followed both ways, with the two outcomes merged at the ENDIF, so the
+ * bounds hold for every path through the script.
+ *
+ * Stack depths are relative to the stack the script starts with, and
+ * cover paths that can succeed (paths ending in OP_RETURN or an invalid
+ * opcode are left out), while the op count, peak depths and element size
+ * cover anything that may run before a failure too.
+ */
+struct ScriptAnalysis {
+    /** SCRIPT_ERR_OK, or why the script fails whatever it is given. */
+    ScriptError error;
+    /** Number of paths through the conditionals (saturating). */
+    size_t paths;
+    /** Items the script may take from the initial stack. */
+    size_t inputs;
+    /** Range of the change in stack depth, once the script has run. */
+    int min_depth;
+    int max_depth;
+    /** Highest the stack and altstack can get above the initial stack. */
+    int peak_depth;
+    int peak_altdepth;
+    /** Largest element the script pushes or computes itself. */
+    size_t max_element_size;
+    /** Accurate sigop count, as counted for consensus (see GetSigOpCount). */
+    unsigned int sigops;
+    /** Highest value nOpCount can reach. */
+    unsigned int max_op_count;
+    /**
+     * Whether an OP_PICK or OP_ROLL takes its index from something other
+     * than a constant pushed right before it, in which case inputs only
+     * counts the items it needs at the very least.
+     */
+    bool dynamic;
+
+    bool IsValid() const { return error == SCRIPT_ERR_OK; }
+    std::string ToString() const;
+};
+
+ScriptAnalysis AnalyzeScript(const CScript& script);
+
+#endif // BITCOIN_BTCDEB_ANALYZE_H
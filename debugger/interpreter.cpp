@@ -8,6 +8,9 @@
 InterpreterEnv::InterpreterEnv(std::vector<valtype>& stack_in, const CScript& script_in, unsigned int flags_in, const BaseSignatureChecker& checker_in, SigVersion sigversion_in, ScriptError* error_in)
 : ScriptExecutionEnvironment(stack_in, script_in, flags_in, checker_in)
 , pc(script.begin())
+, history_pos(0)
+, checkpoint_interval(DEFAULT_CHECKPOINT_INTERVAL)
+, record_history(true)
 , scriptIn(script_in)
 , curr_op_seq(0)
 , done(pc == pend)
@@ -41,28 +44,121 @@ InterpreterEnv::InterpreterEnv(std::vector<valtype>& stack_in, const CScript& sc
 
 bool CastToBool(const valtype& vch);
 
+/**
+ * Determine how many entries from the top of the stack the next operation
+ * may modify. Over-estimating is harmless (the delta simply grows), but
+ * under-estimating would make rewinding incorrect, so whenever the depth
+ * cannot be determined, the whole stack is assumed to be affected.
+ */
+size_t GetStackTouchDepth(opcodetype opcode, const stack_type& stack)
+{
+    try {
+        switch (opcode) {
+        case OP_PICK:
+            // only the top item is replaced; the picked item is copied
+            return 1;
+        case OP_ROLL:
+            if (stack.size() < 1) return 0;
+            return CScriptNum(stack.back(), false).getint() + 2;
+        case OP_CHECKMULTISIG:
+        case OP_CHECKMULTISIGVERIFY: {
+            if (stack.size() < 1) return 0;
+            int nKeysCount = CScriptNum(stack.back(), false).getint();
+            if (nKeysCount < 0 || (size_t)nKeysCount + 2 > stack.size()) return stack.size();
+            int nSigsCount = CScriptNum(stack.at(stack.size() - nKeysCount - 2), false).getint();
+            if (nSigsCount < 0) return stack.size();
+            // sigs, keys, both counts, and the dummy element
+            return nKeysCount + nSigsCount + 3;
+        }
+        default: {
+            size_t spawns, slays;
+            GetStackFeatures(opcode, spawns, slays);
+            return slays;
+        }
+        }
+    } catch (scriptnum_error&) {
+        return stack.size();
+    }
+}
+
+static void TakeCheckpoint(InterpreterEnv& env)
+{
+    env.checkpoints.emplace_back();
+    InterpreterCheckpoint& cp = env.checkpoints.back();
+    cp.op_seq = env.curr_op_seq;
+    cp.history_pos = env.history_pos;
+    cp.script = env.script;
+    cp.pc = env.pc - env.script.begin();
+    cp.pbegincodehash = env.pbegincodehash - env.script.begin();
+    cp.nOpCount = env.nOpCount;
+    cp.stack = env.stack;
+    cp.altstack = env.altstack;
+    cp.vfExec = env.vfExec.values();
+    cp.is_p2sh = env.is_p2sh;
+    cp.p2shstack = env.p2shstack;
+    cp.successor_script = env.successor_script;
+}
+
+static void RestoreCheckpoint(InterpreterEnv& env, const InterpreterCheckpoint& cp)
+{
+    env.curr_op_seq = cp.op_seq;
+    env.history_pos = cp.history_pos;
+    env.script = cp.script;
+    env.decoded.Clear();
+    env.pc = env.script.begin() + cp.pc;
+    env.pend = env.script.end();
+    env.pbegincodehash = env.script.begin() + cp.pbegincodehash;
+    env.nOpCount = cp.nOpCount;
+    env.stack = cp.stack;
+    env.altstack = cp.altstack;
+    env.vfExec.assign(cp.vfExec);
+    env.is_p2sh = cp.is_p2sh;
+    env.p2shstack = cp.p2shstack;
+    env.successor_script = cp.successor_script;
+    env.done = false;
+}
+
 bool StepScript(InterpreterEnv& env)
 {
     auto& pend = env.pend;
     auto& pc = env.pc;
 
+    // Checkpoints are only ever appended in op order, so unless we are
+    // in unexplored territory, we already have the ones we need
+    if (env.record_history && (env.curr_op_seq % env.checkpoint_interval == 0 || pc == env.script.begin())
+        && (env.checkpoints.empty() || env.checkpoints.back().op_seq < env.curr_op_seq)) {
+        TakeCheckpoint(env);
+    }
+
     if (pc < pend) {
-        // Store history entry
-        env.stack_history.push_back(env.stack);
-        env.altstack_history.push_back(env.altstack);
-        env.pc_history.push_back(env.pc);
-        env.nOpCount_history.push_back(env.nOpCount);
+        if (!env.record_history) {
+            if (!StepScript(env, pc)) return false;
+            env.curr_op_seq++;
+            return true;
+        }
+
+        // Store history entry, consisting of the parts of the environment
+        // which the upcoming operation may change, unless we already did so
+        // before rewinding
+        if (env.history_pos == env.history.size()) {
+            if (!env.decoded.IsFor(env.script)) env.decoded.Decode(env.script);
+            size_t index = env.decoded.Find(pc - env.script.begin());
+            opcodetype opcode = index < env.decoded.size() ? env.decoded[index].opcode : OP_INVALIDOPCODE;
+            env.history.emplace_back(pc - env.script.begin(), env.pbegincodehash - env.script.begin(), env.nOpCount);
+            InterpreterStep& h = env.history.back();
+            h.stack.capture(env.stack, GetStackTouchDepth(opcode, env.stack));
+            h.altstack.capture(env.altstack, opcode == OP_FROMALTSTACK ? 1 : 0);
+            h.vfExec.capture(env.vfExec.values(), opcode == OP_ELSE || opcode == OP_ENDIF ? 1 : 0);
+        }
 
         if (!StepScript(env, pc)) {
-            // undo above pushes
-            env.stack_history.pop_back();
-            env.altstack_history.pop_back();
-            env.pc_history.pop_back();
-            env.nOpCount_history.pop_back();
+            // drop above entry
+            env.history.erase(env.history.begin() + env.history_pos, env.history.end());
             return false;
         }
 
         // Update environment
+        env.history_pos++;
         env.curr_op_seq++;
         return true;
     }
@@ -97,6 +193,7 @@ bool StepScript(InterpreterEnv& env)
             const valtype& pubKeySerialized = stack.back();
             CScript pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
             script = pubKey2;
+            env.decoded.Clear();
             popstack(stack);
 
             pc = env.pbegincodehash = script.begin();
@@ -110,6 +207,7 @@ bool StepScript(InterpreterEnv& env)
 
     if (env.successor_script.size()) {
         script = env.successor_script;
+        env.decoded.Clear();
         env.successor_script.clear();
         pc = env.pbegincodehash = script.begin();
         pend = script.end();
@@ -143,24 +241,63 @@ bool StepScript(InterpreterEnv& env)
 
 bool RewindScript(InterpreterEnv& env)
 {
-    if (env.stack_history.size() == 0) {
+    if (env.history_pos == 0) {
         printf("no stack history\n");
         return false;
     }
     // Rewind from history
-    env.stack = env.stack_history.back();
-    env.altstack = env.altstack_history.back();
-    env.pc = env.pc_history.back();
+    const InterpreterStep& h = env.history[--env.history_pos];
+    h.stack.restore(env.stack);
+    h.altstack.restore(env.altstack);
+    h.vfExec.restore(env.vfExec);
+    env.pc = env.script.begin() + h.pc;
+    env.pbegincodehash = env.script.begin() + h.pbegincodehash;
     env.curr_op_seq--;
-    env.nOpCount = env.nOpCount_history.back();
-    // Pop
-    env.stack_history.pop_back();
-    env.altstack_history.pop_back();
-    env.pc_history.pop_back();
-    env.nOpCount_history.pop_back();
+    env.nOpCount = h.nOpCount;
     return true;
 }
 
+bool SeekScript(InterpreterEnv& env, int op_seq)
+{
+    if (op_seq < 0) return false;
+    if (op_seq == env.curr_op_seq) return true;
+
+    // find the last checkpoint at or before op_seq
+    auto it = std::upper_bound(env.checkpoints.begin(), env.checkpoints.end(), op_seq,
+        [](int seq, const InterpreterCheckpoint& cp) { return seq < cp.op_seq; });
+    const InterpreterCheckpoint* cp = it == env.checkpoints.begin() ? nullptr : &*(it - 1);
+
+    if (op_seq < env.curr_op_seq) {
+        if (!cp) return false;
+        // rewinding is only possible within the current script; if we reach
+        // its beginning, fall back to the checkpoint
+        bool rewound = env.curr_op_seq - op_seq <= op_seq - cp->op_seq;
+        while (rewound && env.curr_op_seq > op_seq) {
+            rewound = env.pc != env.script.begin() && RewindScript(env);
+        }
+        if (rewound) {
+            env.done = false;
+            return true;
+        }
+        RestoreCheckpoint(env, *cp);
+    } else if (cp && cp->op_seq > env.curr_op_seq) {
+        RestoreCheckpoint(env, *cp);
+    }
+
+    while (env.curr_op_seq < op_seq && !env.done) {
+        if (!StepScript(env)) return false;
+    }
+    return env.curr_op_seq == op_seq;
+}
+
+void DiscardFuture(InterpreterEnv& env)
+{
+    env.history.erase(env.history.begin() + env.history_pos, env.history.end());
+    while (!env.checkpoints.empty() && env.checkpoints.back().op_seq >= env.curr_op_seq) {
+        env.checkpoints.pop_back();
+    }
+}
+
 bool ContinueScript(InterpreterEnv& env)
 {
     while (!env.done) {
@@ -6,12 +6,9 @@
 #define BITCOIN_BTCDEB_INTERPRETER_H
 
 #include <script/interpreter.h>
+#include <debugger/script.h> // btc_logf
 #include <utilstrencodings.h> // HexStr
 
-template <typename T, typename T2> static inline void print_vec(const T& v, T2 fun) {
-    for (unsigned char c : v) fun("%02x", c);
-}
-
 static inline std::string hashtype_str(int h) {
     char buf[100];
     char* pbuf = buf;
@@ -39,23 +36,178 @@ inline bool set_error(ScriptError* ret, const ScriptError serror)
     return false;
 }
 
+/**
+ * Spare stack element buffers. Items popped off a stack hand their buffer
+ * to the pool, and items pushed are built in a spare buffer when there is
+ * one, so once a script has warmed up the pool, the stack operations of
+ * later steps (and later scripts on the same thread) stop allocating.
+ */
+class StackElementPool {
+public:
+    /** Spare buffers kept at most; as many as can be on the stacks at once. */
+    static const size_t MAX_SPARE = 1000;
+    /** Larger buffers (only initial stack items can be) are freed as usual. */
+    static const size_t MAX_CAPACITY = 520;
+
+    StackElementPool() { spare.reserve(MAX_SPARE); }
+
+    /** Get an empty buffer, with whatever capacity it had before. */
+    valtype Take()
+    {
+        if (spare.empty()) return valtype();
+        valtype v = std::move(spare.back());
+        spare.pop_back();
+        v.clear();
+        return v;
+    }
+
+    valtype Make(const unsigned char* begin, const unsigned char* end)
+    {
+        valtype r = Take();
+        r.assign(begin, end);
+        return r;
+    }
+
+    valtype Make(const valtype& v) { return Make(v.data(), v.data() + v.size()); }
+
+    valtype Make(const CScriptNum& bn)
+    {
+        valtype r = Take();
+        CScriptNum::serialize(bn.getint64(), r);
+        return r;
+    }
+
+    void Release(valtype&& v)
+    {
+        if (spare.size() < MAX_SPARE && v.capacity() && v.capacity() <= MAX_CAPACITY) spare.push_back(std::move(v));
+    }
+
+    size_t size() const { return spare.size(); }
+
+private:
+    std::vector<valtype> spare;
+};
+
+extern thread_local StackElementPool g_stack_pool;
+
+/** Total size of the items pushed onto a stack on this thread, for ScriptProfile. */
+extern thread_local uint64_t g_stack_bytes_pushed;
+
 static inline void _popstack(std::vector<valtype>& stack)
 {
     if (stack.empty())
         throw std::runtime_error("popstack(): stack empty");
+    g_stack_pool.Release(std::move(stack.back()));
     stack.pop_back();
 }
 
+static inline void _pushstack(std::vector<valtype>& stack, const valtype& v)
+{
+    // v may be an item of stack itself, so copy it before the stack can grow
+    valtype item = g_stack_pool.Make(v);
+    g_stack_bytes_pushed += item.size();
+    stack.push_back(std::move(item));
+}
+
+static inline void _pushstack(std::vector<valtype>& stack, valtype&& v)
+{
+    g_stack_bytes_pushed += v.size();
+    stack.push_back(std::move(v));
+}
+
+#ifdef DISABLE_DEBUG_LOGGING
+#define popstack(stack) _popstack(stack)
+#define pushstack(stack, v) _pushstack(stack, v)
+#else
 #define popstack(stack) do { btc_logf("\t\t<> POP  " #stack "\n"); _popstack(stack); } while (0)
-#define pushstack(stack, v) do { stack.push_back(v); btc_logf("\t\t<> PUSH " #stack " %s\n", HexStr(stack.at(stack.size()-1)).c_str()); } while (0)
+#define pushstack(stack, v) do { _pushstack(stack, v); btc_logf("\t\t<> PUSH " #stack " %s\n", HexStr(stack.back()).c_str()); } while (0)
+#endif
+
+/**
+ * Undo information for the part of a stack that a single step may modify.
+ * Script operations only ever touch the top of a stack, so rather than
+ * keeping a full copy, we keep the entries above the lowest position the
+ * step could affect, and restore by truncating and re-appending them.
+ */
+template<typename T>
+struct StackDelta {
+    size_t keep;
+    std::vector<T> removed;
+
+    void capture(const std::vector<T>& stack, size_t depth) {
+        if (depth > stack.size()) depth = stack.size();
+        keep = stack.size() - depth;
+        removed.assign(stack.begin() + keep, stack.end());
+    }
+
+    void restore(std::vector<T>& stack) const {
+        stack.resize(keep);
+        stack.insert(stack.end(), removed.begin(), removed.end());
+    }
+
+    void restore(ConditionStack& stack) const {
+        std::vector<bool> values(stack.values().begin(), stack.values().begin() + std::min(keep, stack.size()));
+        values.insert(values.end(), removed.begin(), removed.end());
+        stack.assign(values);
+    }
+};
+
+/**
+ * A single entry in the step history of an InterpreterEnv. Script positions
+ * are kept as offsets, as the script itself may be replaced when restoring
+ * a checkpoint.
+ */
+struct InterpreterStep {
+    size_t pc;
+    size_t pbegincodehash;
+    int nOpCount;
+    StackDelta<valtype> stack;
+    StackDelta<valtype> altstack;
+    StackDelta<bool> vfExec;
+    InterpreterStep(size_t pc_in, size_t pbegincodehash_in, int nOpCount_in)
+    : pc(pc_in), pbegincodehash(pbegincodehash_in), nOpCount(nOpCount_in) {}
+};
+
+/**
+ * A full snapshot of an InterpreterEnv. Checkpoints are taken every
+ * checkpoint_interval ops, and at the start of each script (P2SH redeem
+ * script, scriptPubKey after scriptSig), which cannot be rewound into
+ * using step history alone.
+ */
+struct InterpreterCheckpoint {
+    int op_seq;
+    size_t history_pos;
+    CScript script;
+    size_t pc;
+    size_t pbegincodehash;
+    int nOpCount;
+    stack_type stack;
+    stack_type altstack;
+    std::vector<bool> vfExec;
+    bool is_p2sh;
+    stack_type p2shstack;
+    CScript successor_script;
+};
+
+static const int DEFAULT_CHECKPOINT_INTERVAL = 64;
 
 struct InterpreterEnv : public ScriptExecutionEnvironment {
     CScriptIter pc;
-    std::vector<stack_type> stack_history;
-    std::vector<stack_type> altstack_history;
-    std::vector<CScriptIter> pc_history;
-    std::vector<int> nOpCount_history;
-    std::vector<CScript> script_history;
+    /**
+     * Step history. Entries up to history_pos describe how to undo the steps
+     * leading up to the current position; entries beyond it were recorded
+     * before a rewind, and are reused if the same steps are taken again.
+     */
+    std::vector<InterpreterStep> history;
+    size_t history_pos;
+    std::vector<InterpreterCheckpoint> checkpoints;
+    int checkpoint_interval;
+    /**
+     * Whether steps are recorded in history and checkpoints. When false,
+     * stepping takes constant memory, but the environment can neither be
+     * rewound nor seeked backwards.
+     */
+    bool record_history;
     const CScript& scriptIn;
     int curr_op_seq;
     bool fRequireMinimal;
@@ -71,8 +223,29 @@ struct InterpreterEnv : public ScriptExecutionEnvironment {
     CScript successor_script;
 };
 
+/**
+ * Determine how many entries from the top of the stack the next operation
+ * (opcode) may modify. May over-estimate, but never under-estimates.
+ */
+size_t GetStackTouchDepth(opcodetype opcode, const stack_type& stack);
+
 bool StepScript(InterpreterEnv& env);
 bool ContinueScript(InterpreterEnv& env);
 bool RewindScript(InterpreterEnv& env);
 
+/**
+ * Move to the given op sequence position, by restoring the closest
+ * checkpoint at or before it and stepping forward, or by rewinding, if
+ * that is cheaper. Returns false if the position could not be reached,
+ * e.g. because the script failed or ended before it.
+ */
+bool SeekScript(InterpreterEnv& env, int op_seq);
+
+/**
+ * Forget about history and checkpoints beyond the current position. This
+ * must be called whenever the environment is modified through some means
+ * other than stepping, as the recorded future may no longer be valid.
+ */
+void DiscardFuture(InterpreterEnv& env);
+
 #endif // BITCOIN_BTCDEB_INTERPRETER_H
@@ -158,7 +158,9 @@ opcodetype GetOpCode(const char* name)
     return OP_INVALIDOPCODE;
 }
 
-void GetStackFeatures(opcodetype opcode, size_t& spawns, size_t& slays)
+namespace {
+
+void StackFeatures(opcodetype opcode, uint8_t& spawns, uint8_t& slays)
 {
     #define _(spawns_out, slays_out) spawns = spawns_out; slays = slays_out; return
     switch (opcode)
@@ -272,3 +274,46 @@ void GetStackFeatures(opcodetype opcode, size_t& spawns, size_t& slays)
     }
     #undef _
 }
+
+struct OpcodeInfoTable {
+    OpcodeInfo info[256];
+    OpcodeInfoTable()
+    {
+        for (int op = 0; op < 256; ++op) {
+            OpcodeInfo& i = info[op];
+            i.disabled =
+                op == OP_CAT ||
+                op == OP_SUBSTR ||
+                op == OP_LEFT ||
+                op == OP_RIGHT ||
+                op == OP_INVERT ||
+                op == OP_AND ||
+                op == OP_OR ||
+                op == OP_XOR ||
+                op == OP_2MUL ||
+                op == OP_2DIV ||
+                op == OP_MUL ||
+                op == OP_DIV ||
+                op == OP_MOD ||
+                op == OP_LSHIFT ||
+                op == OP_RSHIFT;
+            // Note how OP_RESERVED does not count towards the opcode limit.
+            i.counted = op > OP_16;
+            i.conditional = OP_IF <= op && op <= OP_ENDIF;
+            StackFeatures((opcodetype)op, i.spawns, i.slays);
+        }
+    }
+};
+
+const OpcodeInfoTable opcode_info_table;
+
+} // namespace
+
+const OpcodeInfo* const g_opcode_info = opcode_info_table.info;
+
+void GetStackFeatures(opcodetype opcode, size_t& spawns, size_t& slays)
+{
+    const OpcodeInfo& info = GetOpcodeInfo(opcode);
+    spawns = info.spawns;
+    slays = info.slays;
+}
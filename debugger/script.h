@@ -5,6 +5,10 @@
 #ifndef BITCOIN_BTCDEB_SCRIPT_H
 #define BITCOIN_BTCDEB_SCRIPT_H
 
+#if defined(HAVE_CONFIG_H)
+#include <config/bitcoin-config.h>
+#endif
+
 #include <script/script.h>
 
 typedef void (*btc_logf_t) (const char *fmt...);
@@ -13,7 +17,45 @@ void btc_logf_dummy(const char* fmt...);
 void btc_logf_stderr(const char* fmt...);
 inline bool btc_enabled(btc_logf_t logger) { return logger != btc_logf_dummy; }
 
+/**
+ * Calls to the loggers go through the macros below, which check that the
+ * logger is enabled before evaluating any of the arguments. The loggers
+ * themselves can still be assigned and passed around as usual.
+ *
+ * When configured with --disable-debug-logging, the signing, sighash and
+ * segwit loggers are compiled out entirely, along with the per-op tracing
+ * in the interpreter.
+ */
+#define btc_log(logger, ...) do { if (btc_enabled(logger)) logger(__VA_ARGS__); } while (0)
+#define btc_logf(...) btc_log(btc_logf, __VA_ARGS__)
+#ifdef DISABLE_DEBUG_LOGGING
+#define btc_sighash_logf(...) do {} while (0)
+#define btc_sign_logf(...) do {} while (0)
+#define btc_segwit_logf(...) do {} while (0)
+#else
+#define btc_sighash_logf(...) btc_log(btc_sighash_logf, __VA_ARGS__)
+#define btc_sign_logf(...) btc_log(btc_sign_logf, __VA_ARGS__)
+#define btc_segwit_logf(...) btc_log(btc_segwit_logf, __VA_ARGS__)
+#endif
+
 opcodetype GetOpCode(const char* name);
+
+/**
+ * Static properties of an opcode. The interpreter checks these with a
+ * single table lookup per instruction, and the debugger uses the stack
+ * effects to work out what a step may touch.
+ */
+struct OpcodeInfo {
+    bool disabled;    //!< fails the script wherever it appears, even unexecuted
+    bool counted;     //!< counts towards MAX_OPS_PER_SCRIPT
+    bool conditional; //!< OP_IF .. OP_ENDIF, which run in unexecuted branches too
+    uint8_t spawns;   //!< items pushed onto the stack
+    uint8_t slays;    //!< items popped off the stack (some ops take more, see GetStackTouchDepth)
+};
+
+extern const OpcodeInfo* const g_opcode_info;
+inline const OpcodeInfo& GetOpcodeInfo(opcodetype opcode) { return g_opcode_info[(uint8_t)opcode]; }
+
 void GetStackFeatures(opcodetype opcode, size_t& spawns, size_t& slays);
 
 #endif // BITCOIN_BTCDEB_SCRIPT_H
@@ -272,6 +272,27 @@ int parse(const char* args_in)
         return res[0];                                                                  \
     }
 
+// as ARGx_NO_CURVE, but hands all the values to the static Value::vfun at once
+#define ARGx_NO_CURVE_BATCH(vfun)                                                       \
+    std::vector<Value> values;                                                          \
+    if (args.size() == 1 && args[0]->pref) args = env.ctx->arrays.at(args[0]->pref);    \
+    for (auto& v : args) {                                                              \
+        if (v->pref) {                                                                  \
+            throw std::runtime_error("nested complex arguments not allowed");           \
+        }                                                                               \
+        NO_CURVE_CHK(v);                                                                \
+        values.emplace_back(v->data);                                                   \
+    }                                                                                   \
+    Value::vfun(values);                                                                \
+    std::vector<std::shared_ptr<var>> res;                                              \
+    for (auto& v2 : values) res.push_back(std::make_shared<var>(v2));                   \
+    if (res.size() > 1) {                                                               \
+        tiny::ref ref = env.push_arr(res);                                              \
+        return env.pull(ref);                                                           \
+    } else {                                                                            \
+        return res[0];                                                                  \
+    }
+
 std::shared_ptr<var> e_sha256(std::vector<std::shared_ptr<var>> args) {
     ARGx_NO_CURVE(do_sha256)
 }
@@ -287,7 +308,7 @@ std::shared_ptr<var> e_hash256(std::vector<std::shared_ptr<var>> args) {
     ARGx_NO_CURVE(do_hash256);
 }
 std::shared_ptr<var> e_hash160(std::vector<std::shared_ptr<var>> args) {
-    ARGx_NO_CURVE(do_hash160);
+    ARGx_NO_CURVE_BATCH(do_hash160);
 }
 std::shared_ptr<var> e_base58enc(std::vector<std::shared_ptr<var>> args) {
     ARGx_NO_CURVE(do_base58enc);
@@ -7,7 +7,12 @@
 #include <crypto/hmac_sha512.h>
 // #include <pubkey.h>
 
-bool CHashWriter::debug = false;
+void Hash160Batch(unsigned char* output, const Span<const unsigned char>* inputs, size_t count)
+{
+    std::vector<unsigned char> sha(CSHA256::OUTPUT_SIZE * count);
+    SHA256Batch(sha.data(), inputs, count);
+    RIPEMD160Batch32(output, sha.data(), count);
+}
 
 inline uint32_t ROTL32(uint32_t x, int8_t r)
 {
@@ -24,14 +24,12 @@ typedef uint256 ChainCode;
 /** A hasher class for Bitcoin's 256-bit hash (double SHA-256). */
 class CHash256 {
 private:
-    CSHA256 sha;
+    CSHA256D sha;
 public:
-    static const size_t OUTPUT_SIZE = CSHA256::OUTPUT_SIZE;
+    static const size_t OUTPUT_SIZE = CSHA256D::OUTPUT_SIZE;
 
     void Finalize(unsigned char hash[OUTPUT_SIZE]) {
-        unsigned char buf[CSHA256::OUTPUT_SIZE];
-        sha.Finalize(buf);
-        sha.Reset().Write(buf, CSHA256::OUTPUT_SIZE).Finalize(hash);
+        sha.Finalize(hash);
     }
 
     CHash256& Write(const unsigned char *data, size_t len) {
@@ -116,8 +114,15 @@ inline uint160 Hash160(const prevector<N, unsigned char>& vch)
     return Hash160(vch.begin(), vch.end());
 }
 
-/** A writer stream (for serialization) that computes a 256-bit hash. */
-class CHashWriter
+/** Compute the 160-bit hashes of count messages at once; output holds count*20 bytes. */
+void Hash160Batch(unsigned char* output, const Span<const unsigned char>* inputs, size_t count);
+
+/** A writer stream (for serialization) that computes a 256-bit hash.
+ *  DEBUG decides at compile time whether the written bytes can be printed (when
+ *  debug is set); CFastHashWriter leaves that check out of every write.
+ */
+template <bool DEBUG>
+class CBaseHashWriter
 {
 private:
     CHash256 ctx;
@@ -125,15 +130,15 @@ private:
     const int nType;
     const int nVersion;
 public:
-    static bool debug;
+    static thread_local bool debug;
 
-    CHashWriter(int nTypeIn, int nVersionIn) : nType(nTypeIn), nVersion(nVersionIn) {}
+    CBaseHashWriter(int nTypeIn, int nVersionIn) : nType(nTypeIn), nVersion(nVersionIn) {}
 
     int GetType() const { return nType; }
     int GetVersion() const { return nVersion; }
 
     void write(const char *pch, size_t size) {
-        if (debug) {
+        if (DEBUG && debug) {
             printf("#%03zu ", size); for (size_t i = 0; i < size; i++) printf("%02x", (uint8_t)pch[i]);
             printf("\n");
         }
@@ -148,13 +153,19 @@ public:
     }
 
     template<typename T>
-    CHashWriter& operator<<(const T& obj) {
+    CBaseHashWriter& operator<<(const T& obj) {
         // Serialize to this stream
         ::Serialize(*this, obj);
         return (*this);
     }
 };
 
+template <bool DEBUG>
+thread_local bool CBaseHashWriter<DEBUG>::debug = false;
+
+typedef CBaseHashWriter<true> CHashWriter;
+typedef CBaseHashWriter<false> CFastHashWriter;
+
 /** Reads data from an underlying stream, while hashing the read data. */
 template<typename Source>
 class CHashVerifier : public CHashWriter
@@ -194,7 +205,7 @@ public:
 template<typename T>
 uint256 SerializeHash(const T& obj, int nType=SER_GETHASH, int nVersion=PROTOCOL_VERSION)
 {
-    CHashWriter ss(nType, nVersion);
+    CFastHashWriter ss(nType, nVersion);
     ss << obj;
     return ss.GetHash();
 }
@@ -7,55 +7,89 @@
 #include <vector>
 
 #include <instance.h>
+#include <mapped_file.h>
+
+/**
+ * Deserialize a transaction straight out of data, moving its inputs,
+ * outputs and witnesses into place rather than copying them.
+ */
+CTransactionRef parse_tx(Span<const unsigned char> data) {
+    CMutableTransaction mtx;
+    try {
+        SpanReader reader(SER_DISK, 0, data);
+        UnserializeTransaction(mtx, reader);
+    } catch (const std::exception& ex) {
+        fprintf(stderr, "failed to deserialize transaction: %s\n", ex.what());
+        return nullptr;
+    }
+    return MakeTransactionRef(std::move(mtx));
+}
 
 CTransactionRef parse_tx(const char* p) {
-    std::vector<unsigned char> txData = ParseHex(p);
-    if (txData.size() != (strlen(p) >> 1)) {
+    size_t len = strlen(p);
+    std::vector<unsigned char> txData(len >> 1);
+    if (!DecodeHex(p, len, txData.data())) {
         fprintf(stderr, "failed to parse tx hex string\n");
         return nullptr;
     }
-    CDataStream ss(txData, SER_DISK, 0);
-    CMutableTransaction mtx;
-    UnserializeTransaction(mtx, ss);
-    CTransactionRef tx = MakeTransactionRef(CTransaction(mtx));
-    return tx;
+    return parse_tx(Span<const unsigned char>(txData.data(), txData.size()));
 }
 
-bool Instance::parse_transaction(const char* txdata, bool parse_amounts) {
-    // parse until we run out of amounts, if requested
-    const char* p = txdata;
-    if (parse_amounts) {
-        while (1) {
-            const char* c = p;
-            while (*c && *c != ',' && *c != ':') ++c;
-            if (!*c) {
-                if (amounts.size() == 0) {
-                    // no amounts provided
-                    break;
-                }
-                fprintf(stderr, "error: tx hex missing from input\n");
-                return false;
-            }
-            char* s = strndup(p, c-p);
-            std::string ss = s;
-            free(s);
-            CAmount a;
-            if (!ParseFixedPoint(ss, 8, &a)) {
-                fprintf(stderr, "failed to parse amount: %s\n", ss.c_str());
-                return false;
+bool Instance::parse_amount_prefix(const char*& p) {
+    // parse until we run out of amounts
+    while (1) {
+        const char* c = p;
+        while (*c && *c != ',' && *c != ':') ++c;
+        if (!*c) {
+            if (amounts.size() == 0) {
+                // no amounts provided
+                break;
             }
-            amounts.push_back(a);
-            p = c + 1;
-            if (*c == ':') break;
+            fprintf(stderr, "error: tx hex missing from input\n");
+            return false;
+        }
+        char* s = strndup(p, c-p);
+        std::string ss = s;
+        free(s);
+        CAmount a;
+        if (!ParseFixedPoint(ss, 8, &a)) {
+            fprintf(stderr, "failed to parse amount: %s\n", ss.c_str());
+            return false;
         }
+        amounts.push_back(a);
+        p = c + 1;
+        if (*c == ':') break;
     }
-    tx = parse_tx(p);
+    return true;
+}
+
+bool Instance::set_transaction(CTransactionRef tx_in) {
+    tx = std::move(tx_in);
     if (!tx) return false;
+    this->txdata.reset(new PrecomputedTransactionData(*tx));
     while (amounts.size() < tx->vin.size()) amounts.push_back(0);
     if (tx->HasWitness()) sigver = SigVersion::WITNESS_V0;
     return true;
 }
 
+bool Instance::parse_transaction(const char* txdata, bool parse_amounts) {
+    const char* p = txdata;
+    if (parse_amounts && !parse_amount_prefix(p)) return false;
+    return set_transaction(parse_tx(p));
+}
+
+bool Instance::load_transaction_file(const char* arg) {
+    const char* p = arg;
+    if (!parse_amount_prefix(p)) return false;
+    MappedFile file;
+    std::string error;
+    if (!file.open(p, error)) {
+        fprintf(stderr, "error: %s\n", error.c_str());
+        return false;
+    }
+    return set_transaction(parse_tx(file.span()));
+}
+
 bool Instance::parse_input_transaction(const char* txdata, int select_index) {
     txin = parse_tx(txdata);
     if (!txin) return false;
@@ -118,7 +152,7 @@ void Instance::parse_stack_args(size_t argc, char* const* argv, size_t starting_
 
 bool Instance::setup_environment(unsigned int flags) {
     if (tx) {
-        checker = new TransactionSignatureChecker(tx.get(), txin_index > -1 ? txin_index : 0, amounts[txin_index > -1 ? txin_index : 0]);
+        checker = new TransactionSignatureChecker(tx.get(), txin_index > -1 ? txin_index : 0, amounts[txin_index > -1 ? txin_index : 0], *txdata);
     } else {
         checker = new BaseSignatureChecker();
     }
@@ -150,7 +184,7 @@ bool Instance::step(size_t steps) {
 }
 
 bool Instance::rewind() {
-    if (env->pc == env->script.begin()) {
+    if (env->pc == env->script.begin() || !env->record_history) {
         return false;
     }
     if (env->done) {
@@ -159,6 +193,16 @@ bool Instance::rewind() {
     return RewindScript(*env);
 }
 
+bool Instance::seek(size_t op_seq) {
+    exception_string = "";
+    try {
+        return SeekScript(*env, op_seq);
+    } catch (std::exception const& ex) {
+        exception_string = ex.what();
+        return false;
+    }
+}
+
 bool Instance::eval(const size_t argc, char* const* argv) {
     if (argc < 1) return false;
     CScript script;
@@ -207,13 +251,18 @@ bool Instance::eval(const size_t argc, char* const* argv) {
         fprintf(stderr, "error: invalid opcode %s\n", v);
         return false;
     }
+    // the environment is about to diverge from what was recorded
+    DiscardFuture(*env);
     CScriptIter it = script.begin();
     while (it != script.end()) {
         if (!StepScript(*env, it, &script)) {
             fprintf(stderr, "Error: %s\n", ScriptErrorString(*env->serror));
+            env->decoded.Clear();
             return false;
         }
     }
+    // script is going away, so must not be mistaken for a later one
+    env->decoded.Clear();
     return true;
 }
 
@@ -4,16 +4,23 @@
 #include <streams.h>
 #include <pubkey.h>
 #include <value.h>
+#include <memory>
 #include <vector>
 
 typedef std::vector<unsigned char> valtype;
 
+/** Deserialize a raw transaction, printing an error and returning null on failure. */
+CTransactionRef parse_tx(Span<const unsigned char> data);
+/** Decode and deserialize a hex encoded transaction. */
+CTransactionRef parse_tx(const char* p);
+
 class Instance {
 public:
     InterpreterEnv* env;
     int count;
     ECCVerifyHandle evh;
     CTransactionRef tx;
+    std::unique_ptr<PrecomputedTransactionData> txdata; ///< sighash midstates for tx, shared by all signature checks
     CTransactionRef txin;
     int64_t txin_index;             ///< index of the input txid in tx's inputs
     int64_t txin_vout_index;        ///< index inside txin of the output to tx
@@ -41,6 +48,13 @@ public:
     }
 
     bool parse_transaction(const char* txdata, bool parse_amounts = false);
+    /**
+     * Load the transaction from a file holding it in raw (binary) form,
+     * optionally preceded by amounts as for parse_transaction, e.g.
+     * "0.1,0.002:tx.bin". The file is memory mapped, and the transaction
+     * parsed directly out of the mapping.
+     */
+    bool load_transaction_file(const char* arg);
     bool parse_input_transaction(const char* txdata, int select_index = -1);
 
     bool parse_script(const char* script_str);
@@ -61,5 +75,11 @@ public:
 
     bool rewind();
 
+    bool seek(size_t op_seq);
+
     bool eval(const size_t argc, char* const* argv);
+
+private:
+    bool parse_amount_prefix(const char*& p);
+    bool set_transaction(CTransactionRef tx_in);
 };
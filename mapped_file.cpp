@@ -0,0 +1,48 @@
+#include <mapped_file.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::open(const std::string& path, std::string& error)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        error = std::string("unable to open ") + path + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        error = std::string("unable to stat ") + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size == 0) {
+        // mmap refuses empty mappings; there is nothing to read anyway
+        ::close(fd);
+        return true;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int mmap_errno = errno;
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        error = std::string("unable to map ") + path + ": " + strerror(mmap_errno);
+        return false;
+    }
+    madvise(p, st.st_size, MADV_SEQUENTIAL);
+    data = (const unsigned char*)p;
+    length = st.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data) munmap((void*)data, length);
+    data = nullptr;
+    length = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef included_mapped_file_h_
+#define included_mapped_file_h_
+
+#include <string>
+
+#include <span.h>
+
+/**
+ * A read-only memory mapping of an entire file. Pages are read in by the
+ * kernel as they are touched, so the file is never loaded into memory as a
+ * whole, and data can be parsed straight out of the mapping (e.g. using a
+ * SpanReader) without copying it.
+ */
+class MappedFile {
+public:
+    MappedFile() : data(nullptr), length(0) {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * Map the file at path, which is expected to be read from front to
+     * back. On failure, error is set and false is returned.
+     */
+    bool open(const std::string& path, std::string& error);
+    void close();
+
+    size_t size() const { return length; }
+    Span<const unsigned char> span() const { return Span<const unsigned char>(data, length); }
+
+private:
+    const unsigned char* data;
+    size_t length;
+};
+
+#endif // included_mapped_file_h_
@@ -347,7 +347,7 @@ int main(int argc, const char** argv)
                     return -1;
                 }
                 // update path
-                update_path(current_path, paths, env->opcode, env->vfExec);
+                update_path(current_path, paths, env->opcode, env->vfExec.values());
             }
             btc_logf("resulting path: %zu\n", current_path);
             delete env;
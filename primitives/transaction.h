@@ -297,6 +297,9 @@ public:
     CTransaction(const CMutableTransaction &tx);
     CTransaction(CMutableTransaction &&tx);
 
+    /** Convert a CMutableTransaction whose hash has already been computed (e.g. using SHA256DBatch). */
+    CTransaction(CMutableTransaction &&tx, const uint256& hashIn);
+
     template <typename Stream>
     inline void Serialize(Stream& s) const {
         SerializeTransaction(*this, s);
@@ -3,15 +3,99 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <pubkey.h>
+#include <crypto/common.h>
 #include <debugger/script.h> // for btc_*logf
 
 #include <secp256k1.h>
 #include <secp256k1_recovery.h>
 
+#include <atomic>
+
 namespace
 {
 /* Global secp256k1_context object used for verification. */
 secp256k1_context* secp256k1_context_verify = nullptr;
+
+/**
+ * Fixed-size cache of parsed pubkeys, keyed by their serialization. Parsing a
+ * compressed key involves a field square root, and the same keys tend to show
+ * up over and over (hot wallets, multisig cosigners).
+ *
+ * Slots are guarded by a sequence number rather than a lock: a writer makes it
+ * odd while updating the slot, and a reader treats a slot which is being
+ * written, or which changed while it was being read, as a miss. Neither side
+ * ever waits.
+ */
+class ParsedPubKeyCache
+{
+private:
+    static const size_t SLOTS = 4096;
+    static const size_t KEY_WORDS = 9;   //!< length byte + up to 65 bytes of key, padded
+    static const size_t DATA_WORDS = 8;  //!< sizeof(secp256k1_pubkey)
+
+    // No initializers: the cache has static storage, so it is zeroed before
+    // anything can use it, and a zero length never matches a valid key.
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        std::atomic<uint64_t> key[KEY_WORDS];
+        std::atomic<uint64_t> data[DATA_WORDS];
+    };
+    Slot slots[SLOTS];
+
+    static void Pack(const CPubKey& pubkey, uint64_t key[KEY_WORDS]) {
+        unsigned char buf[KEY_WORDS * 8] = {0};
+        buf[0] = pubkey.size();
+        memcpy(buf + 1, pubkey.begin(), pubkey.size());
+        memcpy(key, buf, sizeof(buf));
+    }
+
+    Slot& GetSlot(const CPubKey& pubkey) {
+        // the x coordinate is as good as random
+        return slots[ReadLE64(pubkey.begin() + 1) % SLOTS];
+    }
+
+public:
+    bool Get(const CPubKey& pubkey, secp256k1_pubkey* parsed) {
+        Slot& slot = GetSlot(pubkey);
+        uint32_t seq = slot.seq.load(std::memory_order_acquire);
+        if (seq & 1) return false;
+        uint64_t key[KEY_WORDS], data[DATA_WORDS];
+        for (size_t i = 0; i < KEY_WORDS; ++i) key[i] = slot.key[i].load(std::memory_order_relaxed);
+        for (size_t i = 0; i < DATA_WORDS; ++i) data[i] = slot.data[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq) return false;
+        uint64_t expected[KEY_WORDS];
+        Pack(pubkey, expected);
+        if (memcmp(key, expected, sizeof(key))) return false;
+        memcpy(parsed, data, sizeof(data));
+        return true;
+    }
+
+    void Set(const CPubKey& pubkey, const secp256k1_pubkey* parsed) {
+        Slot& slot = GetSlot(pubkey);
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        // if someone else is writing the slot, let them have it
+        if ((seq & 1) || !slot.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) return;
+        std::atomic_thread_fence(std::memory_order_release);
+        uint64_t key[KEY_WORDS], data[DATA_WORDS];
+        Pack(pubkey, key);
+        memcpy(data, parsed, sizeof(data));
+        for (size_t i = 0; i < KEY_WORDS; ++i) slot.key[i].store(key[i], std::memory_order_relaxed);
+        for (size_t i = 0; i < DATA_WORDS; ++i) slot.data[i].store(data[i], std::memory_order_relaxed);
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+};
+
+ParsedPubKeyCache g_parsed_pubkey_cache;
+
+/** Parse a (valid-looking) pubkey, going through the parsed pubkey cache. */
+bool ParsePubKey(const CPubKey& pubkey, secp256k1_pubkey* parsed)
+{
+    if (g_parsed_pubkey_cache.Get(pubkey, parsed)) return true;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, parsed, pubkey.begin(), pubkey.size())) return false;
+    g_parsed_pubkey_cache.Set(pubkey, parsed);
+    return true;
+}
 } // namespace
 
 /** This function is taken from the libsecp256k1 distribution and implements
@@ -167,12 +251,24 @@ static int ecdsa_signature_parse_der_lax(const secp256k1_context* ctx, secp256k1
 bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
     if (!IsValid())
         return false;
-    secp256k1_pubkey pubkey;
-    secp256k1_ecdsa_signature sig;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+    CParsedPubKey pubkey(*this);
+    if (!pubkey.IsValid()) {
         btc_sign_logf("- pubkey failed to verify: unable to parse pubkey (secp256k1_ec_pubkey_parse)\n");
         return false;
     }
+    return pubkey.Verify(hash, vchSig);
+}
+
+static_assert(sizeof(secp256k1_pubkey) == 64, "CParsedPubKey::data must fit a secp256k1_pubkey");
+
+CParsedPubKey::CParsedPubKey(const CPubKey& pubkey) {
+    fValid = pubkey.IsValid() && ParsePubKey(pubkey, (secp256k1_pubkey*)data);
+}
+
+bool CParsedPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchSig) const {
+    if (!fValid)
+        return false;
+    secp256k1_ecdsa_signature sig;
     if (!ecdsa_signature_parse_der_lax(secp256k1_context_verify, &sig, vchSig.data(), vchSig.size())) {
         btc_sign_logf("- pubkey failed to verify: unable to parse signature (ecdsa_signature_parse_der_lax)\n");
         return false;
@@ -180,7 +276,7 @@ bool CPubKey::Verify(const uint256 &hash, const std::vector<unsigned char>& vchS
     /* libsecp256k1's ECDSA verification requires lower-S signatures, which have
      * not historically been enforced in Bitcoin, so normalize them first. */
     secp256k1_ecdsa_signature_normalize(secp256k1_context_verify, &sig, &sig);
-    bool res = secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), &pubkey);
+    bool res = secp256k1_ecdsa_verify(secp256k1_context_verify, &sig, hash.begin(), (const secp256k1_pubkey*)data);
     btc_sign_logf("- secp256k1_ecdsa_verify() returned %s\n", res ? "success" : "FAILURE");
     return res;
 }
@@ -202,6 +298,8 @@ bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned cha
     size_t publen = 65;
     secp256k1_ec_pubkey_serialize(secp256k1_context_verify, pub, &publen, &pubkey, fComp ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
     Set(pub, pub + publen);
+    // the recovered key is usually verified against next, so save parsing it again
+    g_parsed_pubkey_cache.Set(*this, &pubkey);
     return true;
 }
 
@@ -209,14 +307,14 @@ bool CPubKey::IsFullyValid() const {
     if (!IsValid())
         return false;
     secp256k1_pubkey pubkey;
-    return secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size());
+    return ParsePubKey(*this, &pubkey);
 }
 
 bool CPubKey::Decompress() {
     if (!IsValid())
         return false;
     secp256k1_pubkey pubkey;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+    if (!ParsePubKey(*this, &pubkey)) {
         return false;
     }
     unsigned char pub[65];
@@ -234,7 +332,7 @@ bool CPubKey::Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChi
     BIP32Hash(cc, nChild, *begin(), begin()+1, out);
     memcpy(ccChild.begin(), out+32, 32);
     secp256k1_pubkey pubkey;
-    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkey, &(*this)[0], size())) {
+    if (!ParsePubKey(*this, &pubkey)) {
         return false;
     }
     if (!secp256k1_ec_pubkey_tweak_add(secp256k1_context_verify, &pubkey, out)) {
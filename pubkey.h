@@ -188,6 +188,30 @@ public:
     bool Derive(CPubKey& pubkeyChild, ChainCode &ccChild, unsigned int nChild, const ChainCode& cc) const;
 };
 
+/**
+ * A public key parsed into libsecp256k1's internal representation. Parsing
+ * a compressed key involves a field square root, so when the same key is
+ * used for several verifications, it is cheaper to parse it once and keep
+ * it around in this form.
+ */
+class CParsedPubKey
+{
+private:
+    //! the secp256k1_pubkey, kept opaque to avoid pulling in secp256k1.h
+    unsigned char data[64];
+    bool fValid;
+
+public:
+    CParsedPubKey() : fValid(false) {}
+    explicit CParsedPubKey(const CPubKey& pubkey);
+
+    //! Whether the key was successfully parsed.
+    bool IsValid() const { return fValid; }
+
+    //! Verify a DER signature (~72 bytes), as CPubKey::Verify.
+    bool Verify(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
+};
+
 struct CExtPubKey {
     unsigned char nDepth;
     unsigned char vchFingerprint[4];
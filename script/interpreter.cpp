@@ -12,9 +12,18 @@
 #include <crypto/sha1.h>
 #include <crypto/sha256.h>
 #include <pubkey.h>
+#include <script/sigcache.h>
+#include <streams.h>
 #include <debugger/script.h>
+#include <tinyformat.h>
 #include <uint256.h>
 
+#include <algorithm>
+#include <chrono>
+
+thread_local StackElementPool g_stack_pool;
+thread_local uint64_t g_stack_bytes_pushed = 0;
+
 bool CastToBool(const valtype& vch)
 {
     for (unsigned int i = 0; i < vch.size(); i++)
@@ -202,25 +211,25 @@ bool static CheckPubKeyEncoding(const valtype &vchPubKey, unsigned int flags, co
     return true;
 }
 
-bool static CheckMinimalPush(const valtype& data, opcodetype opcode) {
+bool static CheckMinimalPush(const unsigned char* data, size_t size, opcodetype opcode) {
     // Excludes OP_1NEGATE, OP_1-16 since they are by definition minimal
     assert(0 <= opcode && opcode <= OP_PUSHDATA4);
-    if (data.size() == 0) {
+    if (size == 0) {
         // Should have used OP_0.
         return opcode == OP_0;
-    } else if (data.size() == 1 && data[0] >= 1 && data[0] <= 16) {
+    } else if (size == 1 && data[0] >= 1 && data[0] <= 16) {
         // Should have used OP_1 .. OP_16.
         return false;
-    } else if (data.size() == 1 && data[0] == 0x81) {
+    } else if (size == 1 && data[0] == 0x81) {
         // Should have used OP_1NEGATE.
         return false;
-    } else if (data.size() <= 75) {
+    } else if (size <= 75) {
         // Must have used a direct push (opcode indicating number of bytes pushed + those bytes).
-        return opcode == data.size();
-    } else if (data.size() <= 255) {
+        return opcode == size;
+    } else if (size <= 255) {
         // Must have used OP_PUSHDATA.
         return opcode == OP_PUSHDATA1;
-    } else if (data.size() <= 65535) {
+    } else if (size <= 65535) {
         // Must have used OP_PUSHDATA2.
         return opcode == OP_PUSHDATA2;
     }
@@ -255,6 +264,102 @@ int FindAndDelete(CScript& script, const CScript& b)
     return nFound;
 }
 
+namespace {
+
+/**
+ * Adds the time spent in a StepScript call, and the bytes it pushed, to the
+ * profile entry of the opcode it stepped over.
+ */
+class ProfileScope
+{
+    ScriptProfile* const profile;
+    const opcodetype& opcode;
+    std::chrono::steady_clock::time_point start;
+    uint64_t start_bytes_pushed;
+
+public:
+    ProfileScope(ScriptProfile* profile_in, const opcodetype& opcode_in) : profile(profile_in), opcode(opcode_in)
+    {
+        if (!profile) return;
+        start = std::chrono::steady_clock::now();
+        start_bytes_pushed = g_stack_bytes_pushed;
+    }
+    ~ProfileScope()
+    {
+        if (!profile) return;
+        ScriptProfile::OpStats& stats = profile->ops[opcode];
+        ++stats.count;
+        stats.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        stats.bytes_pushed += g_stack_bytes_pushed - start_bytes_pushed;
+    }
+};
+
+/** Reports the step taken by a StepScript call to the environment's tracer, if any. */
+struct TraceScope
+{
+    const ScriptExecutionEnvironment& env;
+    bool success;
+
+    TraceScope(const ScriptExecutionEnvironment& env_in, const CScript& script, CScriptIter pc) : env(env_in), success(false)
+    {
+        if (env.tracer) env.tracer->BeginStep(env, script, pc);
+    }
+    ~TraceScope()
+    {
+        if (env.tracer) env.tracer->EndStep(env, success);
+    }
+};
+
+} // namespace
+
+bool ScriptProfile::Empty() const
+{
+    for (const OpStats& stats : ops) {
+        if (stats.count) return false;
+    }
+    return true;
+}
+
+std::string ScriptProfile::ToString() const
+{
+    std::vector<int> order;
+    uint64_t total_count = 0, total_ns = 0, total_bytes = 0, total_sigs = 0;
+    for (int op = 0; op < 256; ++op) {
+        if (!ops[op].count) continue;
+        order.push_back(op);
+        total_count += ops[op].count;
+        total_ns += ops[op].nanoseconds;
+        total_bytes += ops[op].bytes_pushed;
+        total_sigs += ops[op].sig_checks;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) { return ops[a].nanoseconds > ops[b].nanoseconds; });
+
+    std::string ret = strprintf("%-22s %10s %12s %10s %6s %12s %10s\n", "opcode", "count", "total us", "ns/op", "time%", "bytes pushed", "sig checks");
+    for (int op : order) {
+        const OpStats& stats = ops[op];
+        ret += strprintf("%-22s %10u %12.1f %10.0f %5.1f%% %12u %10u\n", GetOpName((opcodetype)op), stats.count,
+                         stats.nanoseconds / 1000.0, (double)stats.nanoseconds / stats.count,
+                         total_ns ? 100.0 * stats.nanoseconds / total_ns : 0.0, stats.bytes_pushed, stats.sig_checks);
+    }
+    ret += strprintf("%-22s %10u %12.1f %10s %6s %12u %10u\n", "total", total_count, total_ns / 1000.0, "", "", total_bytes, total_sigs);
+    return ret;
+}
+
+std::string ScriptProfile::ToJSON() const
+{
+    std::string ret = "{\"ops\": [";
+    bool first = true;
+    for (int op = 0; op < 256; ++op) {
+        const OpStats& stats = ops[op];
+        if (!stats.count) continue;
+        ret += strprintf("%s\n  {\"opcode\": \"%s\", \"count\": %u, \"ns\": %u, \"bytes_pushed\": %u, \"sig_checks\": %u}",
+                         first ? "" : ",", GetOpName((opcodetype)op), stats.count, stats.nanoseconds, stats.bytes_pushed, stats.sig_checks);
+        first = false;
+    }
+    ret += "\n]}\n";
+    return ret;
+}
+
 bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local_script)
 {
     static const CScriptNum bnZero(0);
@@ -268,7 +373,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
     auto& pend = env.pend;
     auto& pbegincodehash = env.pbegincodehash;
     auto& opcode = env.opcode;
-    auto& vchPushValue = env.vchPushValue;
+    auto& decoded = env.decoded;
     auto& vfExec = env.vfExec;
     auto& altstack = env.altstack;
     auto& nOpCount = env.nOpCount;
@@ -280,35 +385,33 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
     auto& sigversion = env.sigversion;
     auto& serror = env.serror;
 
-    bool fExec = !count(vfExec.begin(), vfExec.end(), false);
+    bool fExec = vfExec.all_true();
+
+    if (!decoded.IsFor(script)) decoded.Decode(script);
+
+    TraceScope trace_scope(env, script, pc);
+    ProfileScope profile_scope(env.profile, opcode);
 
     //
     // Read instruction
     //
-    if (!script.GetOp(pc, opcode, vchPushValue))
+    size_t index = decoded.Find(pc - script.begin());
+    if (index == decoded.size()) {
+        opcode = OP_INVALIDOPCODE;
         return set_error(serror, SCRIPT_ERR_BAD_OPCODE);
-    if (vchPushValue.size() > MAX_SCRIPT_ELEMENT_SIZE)
+    }
+    const DecodedScript::Instruction& instruction = decoded[index];
+    opcode = instruction.opcode;
+    pc = script.begin() + instruction.next;
+    if (instruction.push_size > MAX_SCRIPT_ELEMENT_SIZE)
         return set_error(serror, SCRIPT_ERR_PUSH_SIZE);
 
-    // Note how OP_RESERVED does not count towards the opcode limit.
-    if (opcode > OP_16 && ++nOpCount > MAX_OPS_PER_SCRIPT)
+    const OpcodeInfo& info = GetOpcodeInfo(opcode);
+
+    if (info.counted && ++nOpCount > MAX_OPS_PER_SCRIPT)
         return set_error(serror, SCRIPT_ERR_OP_COUNT);
 
-    if (opcode == OP_CAT ||
-        opcode == OP_SUBSTR ||
-        opcode == OP_LEFT ||
-        opcode == OP_RIGHT ||
-        opcode == OP_INVERT ||
-        opcode == OP_AND ||
-        opcode == OP_OR ||
-        opcode == OP_XOR ||
-        opcode == OP_2MUL ||
-        opcode == OP_2DIV ||
-        opcode == OP_MUL ||
-        opcode == OP_DIV ||
-        opcode == OP_MOD ||
-        opcode == OP_LSHIFT ||
-        opcode == OP_RSHIFT)
+    if (info.disabled)
         return set_error(serror, SCRIPT_ERR_DISABLED_OPCODE); // Disabled opcodes.
 
     // With SCRIPT_VERIFY_CONST_SCRIPTCODE, OP_CODESEPARATOR in non-segwit script is rejected even in an unexecuted branch
@@ -316,11 +419,12 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
         return set_error(serror, SCRIPT_ERR_OP_CODESEPARATOR);
 
     if (fExec && 0 <= opcode && opcode <= OP_PUSHDATA4) {
-        if (fRequireMinimal && !CheckMinimalPush(vchPushValue, opcode)) {
+        const unsigned char* push_data = decoded.PushData(instruction);
+        if (fRequireMinimal && !CheckMinimalPush(push_data, instruction.push_size, opcode)) {
             return set_error(serror, SCRIPT_ERR_MINIMALDATA);
         }
-        pushstack(stack, vchPushValue);
-    } else if (fExec || (OP_IF <= opcode && opcode <= OP_ENDIF))
+        pushstack(stack, g_stack_pool.Make(push_data, push_data + instruction.push_size));
+    } else if (fExec || info.conditional)
     switch (opcode)
     {
         //
@@ -346,7 +450,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
         {
             // ( -- value)
             CScriptNum bn((int)opcode - (int)(OP_1 - 1));
-            pushstack(stack, bn.getvch());
+            pushstack(stack, g_stack_pool.Make(bn));
             // The result of these opcodes should always be the minimal way to push the data
             // they push, so no need for a CheckMinimalPush here.
         }
@@ -469,7 +573,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
         {
             if (vfExec.empty())
                 return set_error(serror, SCRIPT_ERR_UNBALANCED_CONDITIONAL);
-            vfExec.back() = !vfExec.back();
+            vfExec.toggle_top();
         }
         break;
 
@@ -538,10 +642,8 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 -- x1 x2 x1 x2)
             if (stack.size() < 2)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch1 = stacktop(-2);
-            valtype vch2 = stacktop(-1);
-            pushstack(stack, vch1);
-            pushstack(stack, vch2);
+            pushstack(stack, stacktop(-2));
+            pushstack(stack, stacktop(-2));
         }
         break;
 
@@ -550,12 +652,9 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 x3 -- x1 x2 x3 x1 x2 x3)
             if (stack.size() < 3)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch1 = stacktop(-3);
-            valtype vch2 = stacktop(-2);
-            valtype vch3 = stacktop(-1);
-            pushstack(stack, vch1);
-            pushstack(stack, vch2);
-            pushstack(stack, vch3);
+            pushstack(stack, stacktop(-3));
+            pushstack(stack, stacktop(-3));
+            pushstack(stack, stacktop(-3));
         }
         break;
 
@@ -564,10 +663,8 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 x3 x4 -- x1 x2 x3 x4 x1 x2)
             if (stack.size() < 4)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch1 = stacktop(-4);
-            valtype vch2 = stacktop(-3);
-            pushstack(stack, vch1);
-            pushstack(stack, vch2);
+            pushstack(stack, stacktop(-4));
+            pushstack(stack, stacktop(-4));
         }
         break;
 
@@ -576,11 +673,11 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 x3 x4 x5 x6 -- x3 x4 x5 x6 x1 x2)
             if (stack.size() < 6)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch1 = stacktop(-6);
-            valtype vch2 = stacktop(-5);
+            valtype vch1 = std::move(stacktop(-6));
+            valtype vch2 = std::move(stacktop(-5));
             stack.erase(stack.end()-6, stack.end()-4);
-            pushstack(stack, vch1);
-            pushstack(stack, vch2);
+            pushstack(stack, std::move(vch1));
+            pushstack(stack, std::move(vch2));
         }
         break;
 
@@ -599,9 +696,8 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x - 0 | x x)
             if (stack.size() < 1)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch = stacktop(-1);
-            if (CastToBool(vch))
-                pushstack(stack, vch);
+            if (CastToBool(stacktop(-1)))
+                pushstack(stack, stacktop(-1));
         }
         break;
 
@@ -609,7 +705,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
         {
             // -- stacksize
             CScriptNum bn(stack.size());
-            pushstack(stack, bn.getvch());
+            pushstack(stack, g_stack_pool.Make(bn));
         }
         break;
 
@@ -627,8 +723,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x -- x x)
             if (stack.size() < 1)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch = stacktop(-1);
-            pushstack(stack, vch);
+            pushstack(stack, stacktop(-1));
         }
         break;
 
@@ -637,6 +732,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 -- x2)
             if (stack.size() < 2)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
+            g_stack_pool.Release(std::move(stacktop(-2)));
             stack.erase(stack.end() - 2);
         }
         break;
@@ -646,8 +742,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 -- x1 x2 x1)
             if (stack.size() < 2)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch = stacktop(-2);
-            pushstack(stack, vch);
+            pushstack(stack, stacktop(-2));
         }
         break;
 
@@ -662,10 +757,13 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             popstack(stack);
             if (n < 0 || n >= (int)stack.size())
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch = stacktop(-n-1);
-            if (opcode == OP_ROLL)
+            if (opcode == OP_ROLL) {
+                valtype vch = std::move(stacktop(-n-1));
                 stack.erase(stack.end()-n-1);
-            pushstack(stack, vch);
+                pushstack(stack, std::move(vch));
+            } else {
+                pushstack(stack, stacktop(-n-1));
+            }
         }
         break;
 
@@ -695,8 +793,9 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             // (x1 x2 -- x2 x1 x2)
             if (stack.size() < 2)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
-            valtype vch = stacktop(-1);
-            stack.insert(stack.end()-2, vch);
+            valtype vch = g_stack_pool.Make(stacktop(-1));
+            g_stack_bytes_pushed += vch.size();
+            stack.insert(stack.end()-2, std::move(vch));
         }
         break;
 
@@ -707,7 +806,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             if (stack.size() < 1)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
             CScriptNum bn(stacktop(-1).size());
-            pushstack(stack, bn.getvch());
+            pushstack(stack, g_stack_pool.Make(bn));
         }
         break;
 
@@ -769,7 +868,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             default:            assert(!"invalid opcode"); break;
             }
             popstack(stack);
-            pushstack(stack, bn.getvch());
+            pushstack(stack, g_stack_pool.Make(bn));
         }
         break;
 
@@ -818,7 +917,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             }
             popstack(stack);
             popstack(stack);
-            pushstack(stack, bn.getvch());
+            pushstack(stack, g_stack_pool.Make(bn));
 
             if (opcode == OP_NUMEQUALVERIFY)
             {
@@ -860,7 +959,8 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             if (stack.size() < 1)
                 return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
             valtype& vch = stacktop(-1);
-            valtype vchHash((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
+            valtype vchHash = g_stack_pool.Take();
+            vchHash.resize((opcode == OP_RIPEMD160 || opcode == OP_SHA1 || opcode == OP_HASH160) ? 20 : 32);
             if (opcode == OP_RIPEMD160)
                 CRIPEMD160().Write(vch.data(), vch.size()).Finalize(vchHash.data());
             else if (opcode == OP_SHA1)
@@ -872,7 +972,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
             else if (opcode == OP_HASH256)
                 CHash256().Write(vch.data(), vch.size()).Finalize(vchHash.data());
             popstack(stack);
-            pushstack(stack, vchHash);
+            pushstack(stack, std::move(vchHash));
         }
         break;
 
@@ -911,6 +1011,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
                 return false;
             }
             bool fSuccess = checker.CheckSig(vchSig, vchPubKey, scriptCode, sigversion);
+            if (env.profile) ++env.profile->ops[opcode].sig_checks;
 
             if (!fSuccess && (flags & SCRIPT_VERIFY_NULLFAIL) && vchSig.size())
                 return set_error(serror, SCRIPT_ERR_SIG_NULLFAIL);
@@ -998,6 +1099,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
 
                 // Check signature
                 bool fOk = checker.CheckSig(vchSig, vchPubKey, scriptCode, sigversion);
+                if (env.profile) ++env.profile->ops[opcode].sig_checks;
                 btc_sign_logf("- sig check %s\n", fOk ? "succeeded" : "failed");
 
                 if (fOk) {
@@ -1059,6 +1161,7 @@ bool StepScript(ScriptExecutionEnvironment& env, CScriptIter& pc, CScript* local
     if (stack.size() + altstack.size() > MAX_STACK_SIZE)
         return set_error(serror, SCRIPT_ERR_STACK_SIZE);
 
+    trace_scope.success = true;
     return true;
 }
 
@@ -1071,11 +1174,15 @@ ScriptExecutionEnvironment::ScriptExecutionEnvironment(std::vector<std::vector<u
 , stack(stack_in)
 , flags(flags_in)
 , checker(checker_in)
+, profile(nullptr)
+, tracer(nullptr)
 {}
 
 bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript& script, unsigned int flags, const BaseSignatureChecker& checker, SigVersion sigversion, ScriptError* serror)
 {
     ScriptExecutionEnvironment env(stack, script, flags, checker);
+    env.sigversion = sigversion;
+    env.serror = serror;
     CScriptIter pc = env.script.begin();
     set_error(serror, SCRIPT_ERR_UNKNOWN_ERROR);
     if (env.script.size() > MAX_SCRIPT_SIZE)
@@ -1136,7 +1243,7 @@ public:
         }
         btc_sign_logf(" << scriptCode.size()=%zu - nCodeSeparators=%d\n", scriptCode.size(), nCodeSeparators);
         ::WriteCompactSize(s, scriptCode.size() - nCodeSeparators);
-        btc_sign_logf(" << script:"); print_vec(scriptCode, btc_sign_logf); btc_sign_logf("\n");
+        btc_sign_logf(" << script:%s\n", HexStr(scriptCode).c_str());
         it = itBegin;
         while (scriptCode.GetOp(it, opcode)) {
             if (opcode == OP_CODESEPARATOR) {
@@ -1221,10 +1328,83 @@ public:
     }
 };
 
+/**
+ * Wrapper that serializes the BIP143 signature hash preimage of an input of txTo,
+ *  up to (but not including) the hash type
+ */
+template <class T>
+class CWitnessV0SignatureSerializer
+{
+private:
+    const T& txTo;               //!< reference to the spending transaction
+    const CScript& scriptCode;   //!< script being executed
+    const unsigned int nIn;      //!< input index of txTo being signed
+    const CAmount& amount;       //!< amount of the output being spent
+    const uint256& hashPrevouts; //!< hash of the prevouts committed to (or zero)
+    const uint256& hashSequence; //!< hash of the sequences committed to (or zero)
+    const uint256& hashOutputs;  //!< hash of the outputs committed to (or zero)
+
+public:
+    CWitnessV0SignatureSerializer(const T& txToIn, const CScript& scriptCodeIn, unsigned int nInIn, const CAmount& amountIn,
+                                  const uint256& hashPrevoutsIn, const uint256& hashSequenceIn, const uint256& hashOutputsIn) :
+        txTo(txToIn), scriptCode(scriptCodeIn), nIn(nInIn), amount(amountIn),
+        hashPrevouts(hashPrevoutsIn), hashSequence(hashSequenceIn), hashOutputs(hashOutputsIn) {}
+
+    template<typename S>
+    void Serialize(S &s) const {
+        // Version
+        btc_sign_logf("SERIALIZING:\n");
+        ::Serialize(s, txTo.nVersion);
+        btc_sign_logf(" << txTo.nVersion = %d\n", txTo.nVersion);
+        // Input prevouts/nSequence (none/all, depending on flags)
+        ::Serialize(s, hashPrevouts);
+        btc_sign_logf(" << hashPrevouts\n");
+        ::Serialize(s, hashSequence);
+        btc_sign_logf(" << hashSequence\n");
+        // The input being signed (replacing the scriptSig with scriptCode + amount)
+        // The prevout may already be contained in hashPrevout, and the nSequence
+        // may already be contain in hashSequence.
+        ::Serialize(s, txTo.vin[nIn].prevout);
+        btc_sign_logf(" << txTo.vin[nIn=%d].prevout = %s\n", nIn, txTo.vin[nIn].prevout.ToString().c_str());
+        ::Serialize(s, scriptCode);
+        btc_sign_logf(" << scriptCode\n");
+        ::Serialize(s, amount);
+        btc_sign_logf(" << amount = %" PRId64 "\n", amount);
+        ::Serialize(s, txTo.vin[nIn].nSequence);
+        btc_sign_logf(" << txTo.vin[nIn].nSequence = %u (0x%x)\n", txTo.vin[nIn].nSequence, txTo.vin[nIn].nSequence);
+        // Outputs (none/one/all, depending on flags)
+        ::Serialize(s, hashOutputs);
+        btc_sign_logf(" << hashOutputs\n");
+        // Locktime
+        ::Serialize(s, txTo.nLockTime);
+        btc_sign_logf(" << txTo.nLockTime = %d\n", txTo.nLockTime);
+    }
+};
+
+/**
+ * Hash a signature hash preimage followed by its hash type. The bytes are only
+ * dumped (through the debug-capable CHashWriter) when sighash logging is on;
+ * otherwise the preimage goes straight into the hasher.
+ */
+template <class Preimage>
+uint256 HashSignaturePreimage(const Preimage& preimage, int nHashType)
+{
+    if (btc_enabled(btc_sighash_logf)) {
+        CHashWriter::debug = true;
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << preimage << nHashType;
+        CHashWriter::debug = false;
+        return ss.GetHash();
+    }
+    CFastHashWriter ss(SER_GETHASH, 0);
+    ss << preimage << nHashType;
+    return ss.GetHash();
+}
+
 template <class T>
 uint256 GetPrevoutHash(const T& txTo)
 {
-    CHashWriter ss(SER_GETHASH, 0);
+    CFastHashWriter ss(SER_GETHASH, 0);
     btc_sign_logf("- generating prevout hash from %zu ins\n", txTo.vin.size());
     for (const auto& txin : txTo.vin) {
         ss << txin.prevout;
@@ -1236,7 +1416,7 @@ uint256 GetPrevoutHash(const T& txTo)
 template <class T>
 uint256 GetSequenceHash(const T& txTo)
 {
-    CHashWriter ss(SER_GETHASH, 0);
+    CFastHashWriter ss(SER_GETHASH, 0);
     for (const auto& txin : txTo.vin) {
         ss << txin.nSequence;
     }
@@ -1246,7 +1426,7 @@ uint256 GetSequenceHash(const T& txTo)
 template <class T>
 uint256 GetOutputsHash(const T& txTo)
 {
-    CHashWriter ss(SER_GETHASH, 0);
+    CFastHashWriter ss(SER_GETHASH, 0);
     for (const auto& txout : txTo.vout) {
         ss << txout;
     }
@@ -1271,6 +1451,38 @@ PrecomputedTransactionData::PrecomputedTransactionData(const T& txTo)
 template PrecomputedTransactionData::PrecomputedTransactionData(const CTransaction& txTo);
 template PrecomputedTransactionData::PrecomputedTransactionData(const CMutableTransaction& txTo);
 
+void PrecomputeTransactionDataBatch(const CTransaction* const* txs, PrecomputedTransactionData* const* out, size_t count)
+{
+    // prevouts, sequences and outputs of each transaction with witness, in that order
+    std::vector<std::vector<unsigned char>> data;
+    std::vector<size_t> witness_txs;
+    for (size_t i = 0; i < count; ++i) {
+        if (!txs[i]->HasWitness()) continue;
+        witness_txs.push_back(i);
+        data.emplace_back();
+        CVectorWriter prevouts(SER_GETHASH, 0, data.back(), 0);
+        for (const auto& txin : txs[i]->vin) prevouts << txin.prevout;
+        data.emplace_back();
+        CVectorWriter sequences(SER_GETHASH, 0, data.back(), 0);
+        for (const auto& txin : txs[i]->vin) sequences << txin.nSequence;
+        data.emplace_back();
+        CVectorWriter outputs(SER_GETHASH, 0, data.back(), 0);
+        for (const auto& txout : txs[i]->vout) outputs << txout;
+    }
+    std::vector<Span<const unsigned char>> spans;
+    spans.reserve(data.size());
+    for (const auto& d : data) spans.emplace_back(d.data(), d.size());
+    std::vector<unsigned char> hashes(32 * spans.size());
+    SHA256DBatch(hashes.data(), spans.data(), spans.size());
+    for (size_t k = 0; k < witness_txs.size(); ++k) {
+        PrecomputedTransactionData& txdata = *out[witness_txs[k]];
+        memcpy(txdata.hashPrevouts.begin(), &hashes[96 * k], 32);
+        memcpy(txdata.hashSequence.begin(), &hashes[96 * k + 32], 32);
+        memcpy(txdata.hashOutputs.begin(), &hashes[96 * k + 64], 32);
+        txdata.ready = true;
+    }
+}
+
 template <class T>
 uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn, int nHashType, const CAmount& amount, SigVersion sigversion, const PrecomputedTransactionData* cache)
 {
@@ -1299,45 +1511,15 @@ uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn
             hashOutputs = cacheready ? cache->hashOutputs : GetOutputsHash(txTo);
             btc_sign_logf("  hashOutputs [!single] = %s\n", hashOutputs.ToString().c_str());
         } else if ((nHashType & 0x1f) == SIGHASH_SINGLE && nIn < txTo.vout.size()) {
-            CHashWriter ss(SER_GETHASH, 0);
+            CFastHashWriter ss(SER_GETHASH, 0);
             ss << txTo.vout[nIn];
             hashOutputs = ss.GetHash();
             btc_sign_logf("  hashOutputs [single] = %s\n", hashOutputs.ToString().c_str());
         }
 
-        CHashWriter::debug = btc_enabled(btc_sighash_logf);
-        CHashWriter ss(SER_GETHASH, 0);
-        // Version
-        btc_sign_logf("SERIALIZING:\n");
-        ss << txTo.nVersion;
-        btc_sign_logf(" << txTo.nVersion = %d\n", txTo.nVersion);
-        // Input prevouts/nSequence (none/all, depending on flags)
-        ss << hashPrevouts;
-        btc_sign_logf(" << hashPrevouts\n");
-        ss << hashSequence;
-        btc_sign_logf(" << hashSequence\n");
-        // The input being signed (replacing the scriptSig with scriptCode + amount)
-        // The prevout may already be contained in hashPrevout, and the nSequence
-        // may already be contain in hashSequence.
-        ss << txTo.vin[nIn].prevout;
-        btc_sign_logf(" << txTo.vin[nIn=%d].prevout = %s\n", nIn, txTo.vin[nIn].prevout.ToString().c_str());
-        ss << scriptCode;
-        btc_sign_logf(" << scriptCode\n");
-        ss << amount;
-        btc_sign_logf(" << amount = %" PRId64 "\n", amount);
-        ss << txTo.vin[nIn].nSequence;
-        btc_sign_logf(" << txTo.vin[nIn].nSequence = %u (0x%x)\n", txTo.vin[nIn].nSequence, txTo.vin[nIn].nSequence);
-        // Outputs (none/one/all, depending on flags)
-        ss << hashOutputs;
-        btc_sign_logf(" << hashOutputs\n");
-        // Locktime
-        ss << txTo.nLockTime;
-        btc_sign_logf(" << txTo.nLockTime = %d\n", txTo.nLockTime);
-        // Sighash type
-        ss << nHashType;
+        CWitnessV0SignatureSerializer<T> preimage(txTo, scriptCode, nIn, amount, hashPrevouts, hashSequence, hashOutputs);
+        uint256 sighash = HashSignaturePreimage(preimage, nHashType);
         btc_sign_logf(" << nHashType = %02x\n", nHashType);
-        CHashWriter::debug = false;
-        uint256 sighash = ss.GetHash();
         btc_sign_logf("RESULTING HASH = %s\n", sighash.ToString().c_str());
 
         return sighash;
@@ -1359,18 +1541,60 @@ uint256 SignatureHash(const CScript& scriptCode, const T& txTo, unsigned int nIn
     CTransactionSignatureSerializer<T> txTmp(txTo, scriptCode, nIn, nHashType);
 
     // Serialize and hash
-    CHashWriter::debug = btc_enabled(btc_sighash_logf);
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << txTmp << nHashType;
-    CHashWriter::debug = false;
-    return ss.GetHash();
+    return HashSignaturePreimage(txTmp, nHashType);
+}
+
+bool SigHashCache::Load(const CScript& scriptCode, int nHashType, SigVersion sigversion, uint256& hash) const
+{
+    for (const Entry& entry : entries) {
+        if (entry.nHashType == nHashType && entry.sigversion == sigversion && entry.scriptCode == scriptCode) {
+            hash = entry.hash;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SigHashCache::Store(const CScript& scriptCode, int nHashType, SigVersion sigversion, const uint256& hash)
+{
+    if (entries.size() < MAX_ENTRIES) {
+        entries.push_back(Entry{scriptCode, nHashType, sigversion, hash});
+    }
+}
+
+template <class T>
+const CParsedPubKey& GenericTransactionSignatureChecker<T>::GetParsedPubKey(const CPubKey& pubkey) const
+{
+    for (const auto& entry : parsedkeys) {
+        if (entry.first == pubkey) return entry.second;
+    }
+    // a CHECKMULTISIG has at most MAX_PUBKEYS_PER_MULTISIG keys; past that, start over
+    if (parsedkeys.size() >= (size_t)MAX_PUBKEYS_PER_MULTISIG) parsedkeys.clear();
+    parsedkeys.emplace_back(pubkey, CParsedPubKey(pubkey));
+    return parsedkeys.back().second;
 }
 
 template <class T>
 bool GenericTransactionSignatureChecker<T>::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    btc_sign_logf("  pubkey.Verify(sig="); print_vec(vchSig, btc_sign_logf); btc_sign_logf(", sighash=%s):\n", sighash.ToString().c_str());
-    bool res = pubkey.Verify(sighash, vchSig);
+    btc_sign_logf("  pubkey.Verify(sig=%s, sighash=%s):\n", HexStr(vchSig).c_str(), sighash.ToString().c_str());
+    CSignatureCache* sigcache = GetSignatureCache();
+    uint256 entry;
+    if (sigcache) {
+        sigcache->ComputeEntry(entry, sighash, vchSig, pubkey);
+        if (sigcache->Get(entry)) {
+            btc_sign_logf("  result: success (cached)\n");
+            return true;
+        }
+    }
+    const CParsedPubKey& parsed = GetParsedPubKey(pubkey);
+    if (!parsed.IsValid()) {
+        btc_sign_logf("- pubkey failed to verify: unable to parse pubkey (secp256k1_ec_pubkey_parse)\n");
+        btc_sign_logf("  result: FAILURE\n");
+        return false;
+    }
+    bool res = parsed.Verify(sighash, vchSig);
+    if (res && sigcache) sigcache->Set(entry);
     btc_sign_logf("  result: %s\n", res ? "success" : "FAILURE");
     return res;
 }
@@ -1379,9 +1603,9 @@ template <class T>
 bool GenericTransactionSignatureChecker<T>::CheckSig(const std::vector<unsigned char>& vchSigIn, const std::vector<unsigned char>& vchPubKey, const CScript& scriptCode, SigVersion sigversion) const
 {
     btc_sign_logf("GenericTransactionSignatureChecker::CheckSig(%zu len sig, %zu len pubkey, sigversion=%d)\n", vchSigIn.size(), vchPubKey.size(), sigversion);
-    btc_sign_logf("  sig         = "); print_vec(vchSigIn, btc_sign_logf); btc_sign_logf("\n");
-    btc_sign_logf("  pub key     = "); print_vec(vchPubKey, btc_sign_logf); btc_sign_logf("\n");
-    btc_sign_logf("  script code = "); print_vec(scriptCode, btc_sign_logf); btc_sign_logf("\n");
+    btc_sign_logf("  sig         = %s\n", HexStr(vchSigIn).c_str());
+    btc_sign_logf("  pub key     = %s\n", HexStr(vchPubKey).c_str());
+    btc_sign_logf("  script code = %s\n", HexStr(scriptCode).c_str());
     CPubKey pubkey(vchPubKey);
     if (!pubkey.IsValid()) {
         btc_sign_logf("- failed: pubkey is not valid\n");
@@ -1398,8 +1622,14 @@ bool GenericTransactionSignatureChecker<T>::CheckSig(const std::vector<unsigned
     vchSig.pop_back();
     btc_sign_logf("  hash type   = %02x (%s)\n", nHashType, hashtype_str(nHashType).c_str());
 
-    uint256 sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion, this->txdata);
-    btc_sign_logf("  sighash     = %s\n", sighash.ToString().c_str());
+    uint256 sighash;
+    if (sighashcache.Load(scriptCode, nHashType, sigversion, sighash)) {
+        btc_sign_logf("  sighash     = %s (cached)\n", sighash.ToString().c_str());
+    } else {
+        sighash = SignatureHash(scriptCode, *txTo, nIn, nHashType, amount, sigversion, this->txdata);
+        sighashcache.Store(scriptCode, nHashType, sigversion, sighash);
+        btc_sign_logf("  sighash     = %s\n", sighash.ToString().c_str());
+    }
 
     if (!VerifySignature(vchSig, pubkey, sighash)) {
         btc_sign_logf("- failed: VerifySignature() failed\n");
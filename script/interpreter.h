@@ -8,12 +8,13 @@
 
 #include <script/script_error.h>
 #include <primitives/transaction.h>
+#include <pubkey.h>
 
+#include <algorithm>
 #include <vector>
 #include <stdint.h>
 #include <string>
 
-class CPubKey;
 class CScript;
 class CTransaction;
 class uint256;
@@ -124,10 +125,18 @@ struct PrecomputedTransactionData
     uint256 hashPrevouts, hashSequence, hashOutputs;
     bool ready = false;
 
+    PrecomputedTransactionData() = default;
     template <class T>
     explicit PrecomputedTransactionData(const T& tx);
 };
 
+/**
+ * Fill in out[i] for each of txs[i], as PrecomputedTransactionData(*txs[i])
+ * would, but hashing all of the transactions' prevouts, sequences and outputs
+ * together, using SHA256DBatch.
+ */
+void PrecomputeTransactionDataBatch(const CTransaction* const* txs, PrecomputedTransactionData* const* out, size_t count);
+
 enum class SigVersion
 {
     BASE = 0,
@@ -162,6 +171,31 @@ public:
     virtual ~BaseSignatureChecker() {}
 };
 
+/**
+ * Signature hashes computed by a signature checker. The transaction, input
+ * and amount are fixed for a given checker, so the hash only depends on the
+ * scriptCode, hash type and sigversion. An m-of-n CHECKMULTISIG calls
+ * CheckSig up to n times with the same scriptCode and (usually) hash type,
+ * and only needs to compute the hash once.
+ */
+class SigHashCache
+{
+private:
+    struct Entry {
+        CScript scriptCode;
+        int nHashType;
+        SigVersion sigversion;
+        uint256 hash;
+    };
+    std::vector<Entry> entries;
+
+public:
+    static const size_t MAX_ENTRIES = 16;
+
+    bool Load(const CScript& scriptCode, int nHashType, SigVersion sigversion, uint256& hash) const;
+    void Store(const CScript& scriptCode, int nHashType, SigVersion sigversion, const uint256& hash);
+};
+
 template <class T>
 class GenericTransactionSignatureChecker : public BaseSignatureChecker
 {
@@ -170,6 +204,11 @@ private:
     unsigned int nIn;
     const CAmount amount;
     const PrecomputedTransactionData* txdata;
+    mutable SigHashCache sighashcache;
+    //! pubkeys seen by this checker, parsed once and reused for every signature checked against them
+    mutable std::vector<std::pair<CPubKey, CParsedPubKey>> parsedkeys;
+
+    const CParsedPubKey& GetParsedPubKey(const CPubKey& pubkey) const;
 
 protected:
     virtual bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
@@ -185,13 +224,100 @@ public:
 using TransactionSignatureChecker = GenericTransactionSignatureChecker<CTransaction>;
 using MutableTransactionSignatureChecker = GenericTransactionSignatureChecker<CMutableTransaction>;
 
+/**
+ * Per-opcode execution statistics, collected by StepScript while a profile is
+ * attached to the environment. Opcodes skipped in unexecuted branches are
+ * counted too, as they still take a step.
+ */
+struct ScriptProfile {
+    struct OpStats {
+        uint64_t count = 0;        //!< number of steps taken over the opcode
+        uint64_t nanoseconds = 0;  //!< total time spent stepping over it
+        uint64_t bytes_pushed = 0; //!< total size of the items it pushed onto the stacks, copies and results included
+        uint64_t sig_checks = 0;   //!< number of signature checks it made
+    };
+    OpStats ops[256];
+
+    void Reset() { *this = ScriptProfile(); }
+    bool Empty() const;
+    /** A table of the executed opcodes, most time consuming first. */
+    std::string ToString() const;
+    std::string ToJSON() const;
+};
+
+struct ScriptExecutionEnvironment;
+
+/**
+ * Receives every step StepScript takes, e.g. to record an execution trace.
+ * BeginStep is called before the instruction at pc in script is executed,
+ * and EndStep once it has been executed (or has failed the script).
+ */
+class ScriptTracer
+{
+public:
+    virtual ~ScriptTracer() {}
+    virtual void BeginStep(const ScriptExecutionEnvironment& env, const CScript& script, CScriptIter pc) = 0;
+    virtual void EndStep(const ScriptExecutionEnvironment& env, bool success) = 0;
+};
+
+/**
+ * The stack of IF/NOTIF/ELSE branches being executed. Whether execution is
+ * on is tracked through the position of the first false entry (as in later
+ * Bitcoin Core versions), so checking it takes constant time rather than a
+ * scan of the whole stack; the entries themselves are kept as well, for the
+ * debugger to show and rewind.
+ */
+class ConditionStack
+{
+private:
+    static const size_t NO_FALSE = (size_t)-1;
+
+    std::vector<bool> m_values;
+    size_t m_first_false_pos;
+
+public:
+    ConditionStack() : m_first_false_pos(NO_FALSE) {}
+
+    bool empty() const { return m_values.empty(); }
+    size_t size() const { return m_values.size(); }
+    bool all_true() const { return m_first_false_pos == NO_FALSE; }
+    const std::vector<bool>& values() const { return m_values; }
+
+    void push_back(bool f)
+    {
+        if (m_first_false_pos == NO_FALSE && !f) m_first_false_pos = m_values.size();
+        m_values.push_back(f);
+    }
+    void pop_back()
+    {
+        m_values.pop_back();
+        if (m_first_false_pos == m_values.size()) m_first_false_pos = NO_FALSE;
+    }
+    void toggle_top()
+    {
+        size_t top = m_values.size() - 1;
+        if (m_first_false_pos == NO_FALSE) {
+            m_first_false_pos = top;
+        } else if (m_first_false_pos == top) {
+            m_first_false_pos = NO_FALSE;
+        }
+        m_values[top] = !m_values[top];
+    }
+    void assign(const std::vector<bool>& values)
+    {
+        m_values = values;
+        auto it = std::find(m_values.begin(), m_values.end(), false);
+        m_first_false_pos = it == m_values.end() ? NO_FALSE : it - m_values.begin();
+    }
+};
+
 struct ScriptExecutionEnvironment {
     CScript script;
     CScriptIter pend;
     CScriptIter pbegincodehash;
     opcodetype opcode;
-    std::vector<uint8_t> vchPushValue;
-    std::vector<bool> vfExec;
+    DecodedScript decoded;  //!< the script being stepped through; Clear when reassigning script
+    ConditionStack vfExec;
     std::vector<std::vector<uint8_t>> altstack;
     int nOpCount;
     bool fRequireMinimal;
@@ -200,6 +326,8 @@ struct ScriptExecutionEnvironment {
     const BaseSignatureChecker& checker;
     SigVersion sigversion;
     ScriptError* serror;
+    ScriptProfile* profile; //!< if set, StepScript adds its statistics here
+    ScriptTracer* tracer;   //!< if set, StepScript reports every step to it
     ScriptExecutionEnvironment(std::vector<std::vector<unsigned char> >& stack_in, const CScript& script_in, unsigned int flags_in, const BaseSignatureChecker& checker_in);
 };
 
@@ -8,6 +8,8 @@
 #include <tinyformat.h>
 #include <utilstrencodings.h>
 
+#include <algorithm>
+
 const char* GetOpName(opcodetype opcode)
 {
     switch (opcode)
@@ -327,3 +329,54 @@ bool GetScriptOp(CScriptBase::const_iterator& pc, CScriptBase::const_iterator en
     opcodeRet = static_cast<opcodetype>(opcode);
     return true;
 }
+
+void DecodedScript::Decode(const CScript& script)
+{
+    m_data = script.data();
+    m_size = script.size();
+    m_cursor = 0;
+    m_instructions.clear();
+    CScriptIter pc = script.begin();
+    opcodetype opcode;
+    // count first, to allocate once
+    size_t count = 0;
+    while (script.GetOp(pc, opcode)) ++count;
+    m_instructions.reserve(count);
+    pc = script.begin();
+    for (;;) {
+        CScriptIter start = pc;
+        if (!script.GetOp(pc, opcode)) {
+            m_end = start - script.begin();
+            break;
+        }
+        Instruction ins;
+        ins.opcode = opcode;
+        ins.offset = start - script.begin();
+        ins.next = pc - script.begin();
+        ins.push_size = 0;
+        if (opcode <= OP_PUSHDATA4) {
+            unsigned int header = opcode < OP_PUSHDATA1 ? 1 : opcode == OP_PUSHDATA1 ? 2 : opcode == OP_PUSHDATA2 ? 3 : 5;
+            ins.push_size = ins.next - ins.offset - header;
+        }
+        m_instructions.push_back(ins);
+    }
+}
+
+void DecodedScript::Clear()
+{
+    m_data = nullptr;
+    m_size = m_end = m_cursor = 0;
+    m_instructions.clear();
+}
+
+size_t DecodedScript::Find(size_t offset) const
+{
+    size_t n = m_instructions.size();
+    if (m_cursor < n && m_instructions[m_cursor].offset == offset) return m_cursor;
+    if (m_cursor + 1 < n && m_instructions[m_cursor + 1].offset == offset) return ++m_cursor;
+    auto it = std::lower_bound(m_instructions.begin(), m_instructions.end(), offset,
+                               [](const Instruction& ins, size_t o) { return ins.offset < o; });
+    if (it == m_instructions.end() || it->offset != offset) return n;
+    m_cursor = it - m_instructions.begin();
+    return m_cursor;
+}
@@ -320,10 +320,18 @@ public:
 
     static std::vector<unsigned char> serialize(const int64_t& value)
     {
+        std::vector<unsigned char> result;
+        serialize(value, result);
+        return result;
+    }
+
+    /** Serialize value into result, reusing its storage. */
+    static void serialize(const int64_t& value, std::vector<unsigned char>& result)
+    {
+        result.clear();
         if(value == 0)
-            return std::vector<unsigned char>();
+            return;
 
-        std::vector<unsigned char> result;
         const bool neg = value < 0;
         uint64_t absvalue = neg ? -value : value;
 
@@ -347,8 +355,6 @@ public:
             result.push_back(neg ? 0x80 : 0);
         else if (neg)
             result.back() |= 0x80;
-
-        return result;
     }
 
 private:
@@ -563,6 +569,56 @@ public:
 
 typedef CScript::const_iterator CScriptIter;
 
+/**
+ * A script split into its instructions once, so that stepping through it
+ * or displaying it does not have to run GetOp over it again. Push data is
+ * not copied: instructions refer to the bytes of the script, which must
+ * outlive the decoded form and must not be modified or reassigned without
+ * calling Decode or Clear again.
+ */
+class DecodedScript
+{
+public:
+    struct Instruction {
+        opcodetype opcode;
+        uint32_t offset;    //!< where the instruction starts in the script
+        uint32_t next;      //!< where the instruction after it starts
+        uint32_t push_size; //!< size of the push data, which ends at next
+    };
+
+    DecodedScript() : m_data(nullptr), m_size(0), m_end(0), m_cursor(0) {}
+    explicit DecodedScript(const CScript& script) : DecodedScript() { Decode(script); }
+
+    void Decode(const CScript& script);
+    void Clear();
+
+    /** Whether this is the decoding of script (see the class comment). */
+    bool IsFor(const CScript& script) const { return m_data == script.data() && m_size == script.size(); }
+
+    size_t size() const { return m_instructions.size(); }
+    const Instruction& operator[](size_t i) const { return m_instructions[i]; }
+
+    /** Where decoding stopped; the script size, unless it ends in a truncated push. */
+    size_t End() const { return m_end; }
+    bool Complete() const { return m_end == m_size; }
+
+    /**
+     * Index of the instruction starting at offset, or size() if there is
+     * none. Looking up the instruction following (or the same as) the one
+     * found last time takes constant time.
+     */
+    size_t Find(size_t offset) const;
+
+    const unsigned char* PushData(const Instruction& ins) const { return m_data + ins.next - ins.push_size; }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_end;
+    std::vector<Instruction> m_instructions;
+    mutable size_t m_cursor;
+};
+
 struct CScriptWitness
 {
     // Note that this encodes the data elements being pushed, rather than
@@ -0,0 +1,149 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <script/sigcache.h>
+
+#include <crypto/common.h>
+#include <crypto/sha256.h>
+#include <pubkey.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+
+static const unsigned char SIGCACHE_FILE_MAGIC[8] = {'b', 't', 'c', 'd', 's', 'i', 'g', '1'};
+
+CSignatureCache::CSignatureCache(size_t max_entries)
+: max_entries_per_shard((max_entries + SHARDS - 1) / SHARDS)
+, hits(0)
+, misses(0)
+{
+    std::random_device rd;
+    for (size_t i = 0; i < salt.size(); i += 4) {
+        WriteLE32(salt.begin() + i, rd());
+    }
+}
+
+void CSignatureCache::ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const
+{
+    CSHA256().Write(salt.begin(), 32).Write(hash.begin(), 32).Write(pubkey.begin(), pubkey.size()).Write(vchSig.data(), vchSig.size()).Finalize(entry.begin());
+}
+
+bool CSignatureCache::Get(const uint256& entry)
+{
+    Shard& shard = GetShard(entry);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(entry);
+    if (it == shard.map.end()) {
+        ++misses;
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    ++hits;
+    return true;
+}
+
+void CSignatureCache::Set(const uint256& entry)
+{
+    Shard& shard = GetShard(entry);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(entry);
+    if (it != shard.map.end()) {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    if (shard.map.size() >= max_entries_per_shard) {
+        shard.map.erase(shard.lru.back());
+        shard.lru.pop_back();
+    }
+    shard.lru.push_front(entry);
+    shard.map.emplace(entry, shard.lru.begin());
+}
+
+size_t CSignatureCache::Size()
+{
+    size_t size = 0;
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        size += shard.map.size();
+    }
+    return size;
+}
+
+bool CSignatureCache::Load(const std::string& path)
+{
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) return false;
+    unsigned char header[sizeof(SIGCACHE_FILE_MAGIC) + 32 + 8];
+    if (fread(header, sizeof(header), 1, fp) != 1 || memcmp(header, SIGCACHE_FILE_MAGIC, sizeof(SIGCACHE_FILE_MAGIC))) {
+        fclose(fp);
+        return false;
+    }
+    memcpy(salt.begin(), header + sizeof(SIGCACHE_FILE_MAGIC), 32);
+    uint64_t count = ReadLE64(header + sizeof(SIGCACHE_FILE_MAGIC) + 32);
+    uint256 entry;
+    // entries are stored least recently used first
+    for (uint64_t i = 0; i < count; ++i) {
+        if (fread(entry.begin(), 32, 1, fp) != 1) {
+            fclose(fp);
+            for (Shard& shard : shards) {
+                shard.map.clear();
+                shard.lru.clear();
+            }
+            return false;
+        }
+        Set(entry);
+    }
+    fclose(fp);
+    return true;
+}
+
+bool CSignatureCache::Save(const std::string& path)
+{
+    // write to a new file and rename it into place, so that a failure
+    // part way through leaves the previous cache file intact
+    std::string new_path = path + ".new";
+    FILE* fp = fopen(new_path.c_str(), "wb");
+    if (!fp) return false;
+    unsigned char header[sizeof(SIGCACHE_FILE_MAGIC) + 32 + 8];
+    memcpy(header, SIGCACHE_FILE_MAGIC, sizeof(SIGCACHE_FILE_MAGIC));
+    memcpy(header + sizeof(SIGCACHE_FILE_MAGIC), salt.begin(), 32);
+    for (Shard& shard : shards) shard.mutex.lock();
+    uint64_t count = 0;
+    for (Shard& shard : shards) count += shard.map.size();
+    WriteLE64(header + sizeof(SIGCACHE_FILE_MAGIC) + 32, count);
+    bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+    for (Shard& shard : shards) {
+        for (auto it = shard.lru.rbegin(); ok && it != shard.lru.rend(); ++it) {
+            ok = fwrite(it->begin(), 32, 1, fp) == 1;
+        }
+    }
+    for (Shard& shard : shards) shard.mutex.unlock();
+    ok &= fflush(fp) == 0;
+    ok &= fclose(fp) == 0;
+    if (!ok || rename(new_path.c_str(), path.c_str()) != 0) {
+        remove(new_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+static std::unique_ptr<CSignatureCache> g_signature_cache;
+
+CSignatureCache* GetSignatureCache()
+{
+    return g_signature_cache.get();
+}
+
+void InitSignatureCache(size_t max_entries)
+{
+    g_signature_cache.reset(new CSignatureCache(max_entries));
+}
+
+void DestroySignatureCache()
+{
+    g_signature_cache.reset();
+}
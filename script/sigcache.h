@@ -0,0 +1,92 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SCRIPT_SIGCACHE_H
+#define BITCOIN_SCRIPT_SIGCACHE_H
+
+#include <uint256.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CPubKey;
+
+static const size_t DEFAULT_SIGNATURE_CACHE_ENTRIES = 1 << 18;
+
+/**
+ * Cache of (sighash, pubkey, signature) triples which are known to verify.
+ *
+ * Entries are salted hashes of the triple, so that the cache content cannot
+ * be predicted (and collided with) by whoever supplies the signatures. Only
+ * successful verifications are stored. The cache is split into shards, each
+ * with its own lock and LRU eviction, so it can be used from several
+ * verification threads at once.
+ *
+ * The cache can be saved to and loaded from disk, along with its salt, so
+ * that repeated runs over the same data do not need to verify again.
+ */
+class CSignatureCache
+{
+private:
+    struct EntryHasher {
+        size_t operator()(const uint256& entry) const { return entry.GetCheapHash(); }
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<uint256> lru; //!< most recently used first
+        std::unordered_map<uint256, std::list<uint256>::iterator, EntryHasher> map;
+    };
+
+    static const size_t SHARDS = 16;
+
+    uint256 salt;
+    size_t max_entries_per_shard;
+    Shard shards[SHARDS];
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    Shard& GetShard(const uint256& entry) { return shards[entry.begin()[31] % SHARDS]; }
+
+public:
+    explicit CSignatureCache(size_t max_entries = DEFAULT_SIGNATURE_CACHE_ENTRIES);
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubkey) const;
+
+    //! Look up an entry, counting the hit or miss.
+    bool Get(const uint256& entry);
+    void Set(const uint256& entry);
+
+    size_t Size();
+    uint64_t Hits() const { return hits; }
+    uint64_t Misses() const { return misses; }
+
+    /**
+     * Load entries from a file written by Save(). The cache must be empty,
+     * as it takes on the salt of the file. Returns false if the file could
+     * not be read, in which case the cache is left empty.
+     */
+    bool Load(const std::string& path);
+    /**
+     * Write all entries to path. The file is written as path + ".new" and
+     * then renamed over path, which is left untouched if writing fails.
+     */
+    bool Save(const std::string& path);
+};
+
+/** The cache used by signature checkers, or nullptr if caching is disabled (the default). */
+CSignatureCache* GetSignatureCache();
+
+/** Enable signature caching, using a cache of the given size. */
+void InitSignatureCache(size_t max_entries = DEFAULT_SIGNATURE_CACHE_ENTRIES);
+
+/** Disable signature caching, discarding the cache. */
+void DestroySignatureCache();
+
+#endif // BITCOIN_SCRIPT_SIGCACHE_H
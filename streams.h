@@ -8,6 +8,7 @@
 
 #include <support/allocators/zeroafterfree.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -138,6 +139,62 @@ private:
     size_t nPos;
 };
 
+/** Minimal stream for reading from a span of bytes owned by someone else,
+ * e.g. a decoded hex string or a memory mapped file, without copying it.
+ *
+ * The referenced data must outlive the reader.
+ */
+class SpanReader
+{
+private:
+    const int m_type;
+    const int m_version;
+    Span<const unsigned char> m_data;
+    size_t m_pos;
+
+public:
+    /*
+     * @param[in]  type Serialization Type
+     * @param[in]  version Serialization Version (including any flags)
+     * @param[in]  data Referenced byte span to read from
+     */
+    SpanReader(int type, int version, Span<const unsigned char> data) : m_type(type), m_version(version), m_data(data), m_pos(0) {}
+
+    template<typename T>
+    SpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    int GetVersion() const { return m_version; }
+    int GetType() const { return m_type; }
+
+    size_t size() const { return m_data.size() - m_pos; }
+    bool empty() const { return size() == 0; }
+    /** Offset of the next byte to be read, from the beginning of the span. */
+    size_t tell() const { return m_pos; }
+
+    void read(char* dst, size_t n)
+    {
+        if (n == 0) return;
+        if (n > size()) {
+            throw std::ios_base::failure("SpanReader::read(): end of data");
+        }
+        memcpy(dst, m_data.data() + m_pos, n);
+        m_pos += n;
+    }
+
+    void ignore(size_t n)
+    {
+        if (n > size()) {
+            throw std::ios_base::failure("SpanReader::ignore(): end of data");
+        }
+        m_pos += n;
+    }
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
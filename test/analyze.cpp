@@ -0,0 +1,89 @@
+#include "catch.hpp"
+
+#include "../debugger/analyze.h"
+#include "../value.h"
+
+static ScriptAnalysis analyze(const char* script) {
+    VALUE_WARN = false;
+    std::vector<unsigned char> data = Value(script).data_value();
+    return AnalyzeScript(CScript(data.begin(), data.end()));
+}
+
+TEST_CASE("Static script analysis", "[analyze]") {
+    btc_logf = btc_logf_dummy;
+
+    SECTION("P2PKH") {
+        ScriptAnalysis a = analyze("[OP_DUP OP_HASH160 0x1290b657a78e201967c22d8022b348bd5e23ce17 OP_EQUALVERIFY OP_CHECKSIG]");
+        REQUIRE(a.IsValid());
+        REQUIRE(a.paths == 1);
+        REQUIRE(a.inputs == 2);
+        REQUIRE(a.min_depth == -1);
+        REQUIRE(a.max_depth == -1);
+        REQUIRE(a.peak_depth == 2);
+        REQUIRE(a.max_element_size == 20);
+        REQUIRE(a.sigops == 1);
+        REQUIRE(a.max_op_count == 4);
+        REQUIRE(!a.dynamic);
+    }
+
+    SECTION("Multisig") {
+        ScriptAnalysis a = analyze("[2 0x0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c 0x03a1b26313f430c4b15bb1fdce663207659d8cac749a0e53d70eff01874496feff 0x03c96d495bfdd5ba4145e3e046fee45e84a8a48ad05bd8dbb395c011a32cf9f880 3 OP_CHECKMULTISIG]");
+        REQUIRE(a.IsValid());
+        // the dummy element and two signatures
+        REQUIRE(a.inputs == 3);
+        REQUIRE(a.min_depth == -2);
+        REQUIRE(a.max_depth == -2);
+        REQUIRE(a.max_element_size == 33);
+        REQUIRE(a.sigops == 3);
+        REQUIRE(a.max_op_count == 4);
+    }
+
+    SECTION("Branches") {
+        ScriptAnalysis a = analyze("[OP_IF 1 2 OP_ELSE 3 OP_ENDIF OP_NOTIF 4 OP_ENDIF]");
+        REQUIRE(a.IsValid());
+        REQUIRE(a.paths == 4);
+        REQUIRE(a.inputs == 1);
+        REQUIRE(a.min_depth == -1);
+        REQUIRE(a.max_depth == 1);
+        REQUIRE(a.peak_depth == 1);
+
+        // paths that fail are left out of the depths
+        a = analyze("[OP_IF OP_RETURN OP_ELSE 1 OP_ENDIF]");
+        REQUIRE(a.IsValid());
+        REQUIRE(a.paths == 1);
+        REQUIRE(a.min_depth == 0);
+        REQUIRE(a.max_depth == 0);
+    }
+
+    SECTION("Stack items picked by constant index") {
+        ScriptAnalysis a = analyze("[3 OP_PICK OP_TOALTSTACK OP_FROMALTSTACK]");
+        REQUIRE(a.inputs == 4);
+        REQUIRE(a.max_depth == 1);
+        REQUIRE(a.peak_altdepth == 1);
+        REQUIRE(!a.dynamic);
+        a = analyze("[998 OP_PICK]");
+        REQUIRE(a.IsValid());
+        REQUIRE(a.inputs == 999);
+        // indices whose items cannot fit on the stack always fail
+        REQUIRE(analyze("[999 OP_PICK]").error == SCRIPT_ERR_INVALID_STACK_OPERATION);
+        REQUIRE(analyze("[1000 OP_ROLL]").error == SCRIPT_ERR_INVALID_STACK_OPERATION);
+        REQUIRE(analyze("[2147483647 OP_PICK]").error == SCRIPT_ERR_INVALID_STACK_OPERATION);
+        REQUIRE(analyze("[-1 OP_PICK]").error == SCRIPT_ERR_INVALID_STACK_OPERATION);
+        a = analyze("[OP_ROLL]");
+        REQUIRE(a.inputs == 2);
+        REQUIRE(a.dynamic);
+    }
+
+    SECTION("Failures") {
+        REQUIRE(analyze("[1 OP_IF 1]").error == SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+        REQUIRE(analyze("[1 OP_ENDIF]").error == SCRIPT_ERR_UNBALANCED_CONDITIONAL);
+        REQUIRE(analyze("[0 OP_IF OP_MUL OP_ENDIF 1]").error == SCRIPT_ERR_DISABLED_OPCODE);
+        REQUIRE(analyze("[0 OP_IF OP_VERIF OP_ENDIF 1]").error == SCRIPT_ERR_BAD_OPCODE);
+        REQUIRE(analyze("[1 OP_RETURN]").error == SCRIPT_ERR_OP_RETURN);
+        REQUIRE(analyze("[OP_FROMALTSTACK]").error == SCRIPT_ERR_INVALID_ALTSTACK_OPERATION);
+        std::string ops = "[";
+        for (int i = 0; i < 202; ++i) ops += "OP_NOP ";
+        REQUIRE(analyze((ops + "]").c_str()).error == SCRIPT_ERR_OP_COUNT);
+        REQUIRE(analyze("[1 OP_RETURN]").ToString().find("fails: OP_RETURN was encountered") == 0);
+    }
+}
@@ -0,0 +1,127 @@
+#include "catch.hpp"
+#include "fixtures.h"
+
+#include "../batch.h"
+#include "../instance.h"
+#include "../crypto/sha256.h"
+
+TEST_CASE("Batch verification", "[batch]") {
+    btc_logf = btc_logf_dummy;
+    ECCVerifyHandle evh;
+
+    SECTION("Parsing records") {
+        BatchRecord record;
+        std::string error;
+        REQUIRE(parse_batch_record(TXHEX " " TXSPK " " TXAMT "\n", record, error));
+        REQUIRE(record.tx->vin.size() == 1);
+        REQUIRE(HexStr(record.spent_scripts[0]) == TXSPK);
+        REQUIRE(record.amounts[0] == 894702400);
+
+        // missing amount
+        REQUIRE(!parse_batch_record(TXHEX " " TXSPK, record, error));
+        // wrong number of inputs
+        REQUIRE(!parse_batch_record(TXHEX " " TXSPK " " TXAMT " " TXSPK " " TXAMT, record, error));
+        // truncated transaction
+        REQUIRE(!parse_batch_record("01000000 " TXSPK " " TXAMT, record, error));
+        // bad amount
+        REQUIRE(!parse_batch_record(TXHEX " " TXSPK " 1.2.3", record, error));
+    }
+
+    SECTION("Verifying records") {
+        BatchRecord record;
+        std::string error;
+        std::vector<ScriptError> results;
+        REQUIRE(parse_batch_record(TXHEX " " TXSPK " " TXAMT, record, error));
+        verify_batch_record(record, STANDARD_SCRIPT_VERIFY_FLAGS, results);
+        REQUIRE(results.size() == 1);
+        REQUIRE(results[0] == SCRIPT_ERR_OK);
+
+        // the amount is committed to by segwit signatures
+        REQUIRE(parse_batch_record(TXHEX " " TXSPK " 8.947025", record, error));
+        verify_batch_record(record, STANDARD_SCRIPT_VERIFY_FLAGS, results);
+        REQUIRE(results[0] == SCRIPT_ERR_SIG_NULLFAIL);
+    }
+
+    SECTION("Running a batch") {
+        FILE* in = tmpfile();
+        FILE* out = tmpfile();
+        fputs("# comment\n\n", in);
+        fputs(TXHEX " " TXSPK " " TXAMT "\n", in);
+        fputs(TXHEX " " TXSPK " 1\n", in);
+        fputs("garbage\n", in);
+        rewind(in);
+        BatchStats stats = run_batch(in, out, STANDARD_SCRIPT_VERIFY_FLAGS);
+        REQUIRE(stats.records == 3);
+        REQUIRE(stats.inputs == 2);
+        REQUIRE(stats.failures == 1);
+        REQUIRE(stats.invalid_records == 1);
+
+        rewind(out);
+        char buf[256];
+        REQUIRE(fgets(buf, sizeof(buf), out));
+        REQUIRE(std::string(buf).find(":0 ok\n") == 64);
+        REQUIRE(fgets(buf, sizeof(buf), out));
+        REQUIRE(std::string(buf).find(":0 error: ") == 64);
+        REQUIRE(!fgets(buf, sizeof(buf), out));
+        fclose(in);
+        fclose(out);
+    }
+
+    SECTION("Multiple threads") {
+        FILE* in = tmpfile();
+        for (int i = 0; i < 50; ++i) {
+            fputs(TXHEX " " TXSPK " " TXAMT "\n", in);
+            fputs(TXHEX " " TXSPK " 1\n", in);
+        }
+        std::string expected;
+        for (size_t threads : {1, 4}) {
+            rewind(in);
+            FILE* out = tmpfile();
+            BatchStats stats = run_batch(in, out, STANDARD_SCRIPT_VERIFY_FLAGS, threads);
+            REQUIRE(stats.inputs == 100);
+            REQUIRE(stats.failures == 50);
+            std::string output;
+            char buf[256];
+            rewind(out);
+            while (fgets(buf, sizeof(buf), out)) output += buf;
+            fclose(out);
+            if (threads == 1) expected = output;
+            REQUIRE(output == expected);
+        }
+        fclose(in);
+    }
+
+    SECTION("Hashing records together") {
+        // make sure the SIMD lanes, if any, are in use
+        SHA256AutoDetect();
+        BatchRecord record;
+        std::string error;
+        REQUIRE(parse_batch_record(TXHEX " " TXSPK " " TXAMT, record, error));
+
+        std::vector<const CTransaction*> txs(20, record.tx.get());
+        std::vector<PrecomputedTransactionData> txdata(txs.size());
+        std::vector<PrecomputedTransactionData*> txdata_ptrs;
+        for (auto& d : txdata) txdata_ptrs.push_back(&d);
+        PrecomputeTransactionDataBatch(txs.data(), txdata_ptrs.data(), txs.size());
+        for (const auto& d : txdata) {
+            REQUIRE(d.ready);
+            REQUIRE(d.hashPrevouts == record.txdata->hashPrevouts);
+            REQUIRE(d.hashSequence == record.txdata->hashSequence);
+            REQUIRE(d.hashOutputs == record.txdata->hashOutputs);
+        }
+
+        FILE* in = tmpfile();
+        for (int i = 0; i < 20; ++i) fputs(TXHEX " " TXSPK " " TXAMT "\n", in);
+        rewind(in);
+        FILE* out = tmpfile();
+        BatchStats stats = run_batch(in, out, STANDARD_SCRIPT_VERIFY_FLAGS);
+        REQUIRE(stats.failures == 0);
+        rewind(out);
+        char buf[256];
+        while (fgets(buf, sizeof(buf), out)) {
+            REQUIRE(std::string(buf) == record.tx->GetHash().ToString() + ":0 ok\n");
+        }
+        fclose(in);
+        fclose(out);
+    }
+}
@@ -0,0 +1,125 @@
+#include "catch.hpp"
+
+#include "../crypto/ripemd160.h"
+#include "../crypto/sha256.h"
+#include "../hash.h"
+#include "../utilstrencodings.h"
+
+static std::vector<unsigned char> DoubleSHA256(const unsigned char* data, size_t len) {
+    std::vector<unsigned char> hash(CSHA256::OUTPUT_SIZE);
+    CSHA256().Write(data, len).Finalize(hash.data());
+    CSHA256().Write(hash.data(), hash.size()).Finalize(hash.data());
+    return hash;
+}
+
+TEST_CASE("SHA256 implementations", "[sha256]") {
+    // 19 blocks, so that the 8-way, 4-way and 1-way paths are all taken
+    std::vector<unsigned char> in(64 * 19);
+    for (size_t i = 0; i < in.size(); ++i) in[i] = (unsigned char)(i * 7 + (i >> 6));
+    std::vector<unsigned char> expected;
+    for (size_t i = 0; i < 19; ++i) {
+        std::vector<unsigned char> hash = DoubleSHA256(&in[64 * i], 64);
+        expected.insert(expected.end(), hash.begin(), hash.end());
+    }
+
+    // asserts that every selected implementation passes its self test
+    std::string impl = SHA256AutoDetect();
+    INFO("using " << impl);
+    REQUIRE(!impl.empty());
+
+    unsigned char abc[32];
+    CSHA256().Write((const unsigned char*)"abc", 3).Finalize(abc);
+    REQUIRE(HexStr(abc, abc + 32) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+    std::vector<unsigned char> out(32 * 19);
+    SHA256D64(out.data(), in.data(), 19);
+    REQUIRE(out == expected);
+    for (size_t i = 0; i < 19; ++i) {
+        REQUIRE(DoubleSHA256(&in[64 * i], 64) == std::vector<unsigned char>(&expected[32 * i], &expected[32 * (i + 1)]));
+    }
+}
+
+TEST_CASE("SHA256 batches", "[sha256]") {
+    SHA256AutoDetect();
+    // lengths around every padding boundary, and enough messages that some
+    // lanes are refilled while others are still busy
+    std::vector<std::vector<unsigned char>> msgs;
+    for (size_t len = 0; len < 300; len += (len % 64 > 50 || len % 64 < 3) ? 1 : 13) {
+        std::vector<unsigned char> msg(len);
+        for (size_t i = 0; i < len; ++i) msg[i] = (unsigned char)(len + i * 31);
+        msgs.push_back(msg);
+    }
+    std::vector<Span<const unsigned char>> spans;
+    for (const auto& msg : msgs) spans.emplace_back(msg.data(), msg.size());
+
+    for (size_t count : {msgs.size(), (size_t)3, (size_t)0}) {
+        std::vector<unsigned char> single(32 * count), twice(32 * count);
+        SHA256Batch(single.data(), spans.data(), count);
+        SHA256DBatch(twice.data(), spans.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            unsigned char hash[32];
+            CSHA256().Write(msgs[i].data(), msgs[i].size()).Finalize(hash);
+            REQUIRE(std::vector<unsigned char>(hash, hash + 32) == std::vector<unsigned char>(&single[32 * i], &single[32 * (i + 1)]));
+            REQUIRE(DoubleSHA256(msgs[i].data(), msgs[i].size()) == std::vector<unsigned char>(&twice[32 * i], &twice[32 * (i + 1)]));
+        }
+    }
+}
+
+TEST_CASE("Streaming double-SHA256", "[sha256]") {
+    SHA256AutoDetect();
+    std::vector<unsigned char> in(400);
+    for (size_t i = 0; i < in.size(); ++i) in[i] = (unsigned char)(i * 11 + 5);
+    // split every message into writes of varying sizes, so that writes fill,
+    // straddle and skip whole blocks
+    for (size_t len = 0; len < in.size(); len += (len % 64 > 50 || len % 64 < 3) ? 1 : 17) {
+        CSHA256D hasher;
+        for (size_t pos = 0, step = 1; pos < len; pos += step, step = step * 3 % 71 + 1) {
+            hasher.Write(&in[pos], std::min(step, len - pos));
+        }
+        std::vector<unsigned char> hash(32);
+        hasher.Finalize(hash.data());
+        REQUIRE(hash == DoubleSHA256(in.data(), len));
+    }
+
+    uint256 expected = Hash(in.begin(), in.end());
+    CHashWriter slow(SER_GETHASH, 0);
+    CFastHashWriter fast(SER_GETHASH, 0);
+    slow << in;
+    fast << in;
+    REQUIRE(slow.GetHash() == fast.GetHash());
+    CFastHashWriter raw(SER_GETHASH, 0);
+    raw.write((const char*)in.data(), in.size());
+    REQUIRE(raw.GetHash() == expected);
+}
+
+TEST_CASE("RIPEMD160 batches", "[ripemd160]") {
+    std::string impl = RIPEMD160AutoDetect();
+    INFO("using " << impl);
+    SHA256AutoDetect();
+
+    // 19 messages, so that the 8-way, 4-way and 1-way paths are all taken
+    std::vector<unsigned char> in(32 * 19);
+    for (size_t i = 0; i < in.size(); ++i) in[i] = (unsigned char)(i * 13 + (i >> 5));
+    for (size_t count : {(size_t)19, (size_t)3}) {
+        std::vector<unsigned char> out(20 * count);
+        RIPEMD160Batch32(out.data(), in.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            unsigned char hash[20];
+            CRIPEMD160().Write(&in[32 * i], 32).Finalize(hash);
+            REQUIRE(std::vector<unsigned char>(hash, hash + 20) == std::vector<unsigned char>(&out[20 * i], &out[20 * (i + 1)]));
+        }
+    }
+
+    SECTION("hash160") {
+        std::vector<std::vector<unsigned char>> msgs;
+        for (size_t len = 0; len < 150; len += 7) msgs.emplace_back(&in[0], &in[len]);
+        std::vector<Span<const unsigned char>> spans;
+        for (const auto& msg : msgs) spans.emplace_back(msg.data(), msg.size());
+        std::vector<unsigned char> out(20 * msgs.size());
+        Hash160Batch(out.data(), spans.data(), msgs.size());
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            uint160 hash = Hash160(msgs[i]);
+            REQUIRE(std::vector<unsigned char>(hash.begin(), hash.end()) == std::vector<unsigned char>(&out[20 * i], &out[20 * (i + 1)]));
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef included_test_fixtures_h_
+#define included_test_fixtures_h_
+
+#include "catch.hpp"
+
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// P2WSH 2-of-3 multisig spend (see test/signing.cpp): the transaction, and
+// the scriptPubKey and amount of the output it spends
+#define TXHEX  "010000000001019086ce64fce1bb086395faf6fac37c73f32ba4ea89330432bf8ee8035e9315aa0100000000ffffffff021353b9030000000017a914c3f413d0918853a8e23766678d2e3c2e5c8138bb8725e4973100000000220020701a8d401c84fb13e6baf169d59684e17abd9fa216c8cc5b9fc63d622ff8c58d040047304402207f874ef00f11dcc9a621acad9354f3fca1bf90c43878f607b7e2d358088487e7022052a01b47b8eef5e1c96a6affdc3dac46fdc11b60612464dc8c5921a852090d2701483045022100c56ab2abb17fdf565417228763bc9f2940a6465042fd62fbd9f4c7406345d7f702201cb1a56b45181f8347713627b325ec5df48fc1aee6bdaf937cbb804d7409b10c016952210375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c2103a1b26313f430c4b15bb1fdce663207659d8cac749a0e53d70eff01874496feff2103c96d495bfdd5ba4145e3e046fee45e84a8a48ad05bd8dbb395c011a32cf9f88053ae00000000"
+#define TXSPK  "0020701a8d401c84fb13e6baf169d59684e17abd9fa216c8cc5b9fc63d622ff8c58d"
+#define TXAMT  "8.947024"
+
+/** Write data to a new temporary file, returning its path. */
+inline std::string write_temp_file(const std::vector<unsigned char>& data) {
+    char path[] = "/tmp/btcdeb-test-XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd != -1);
+    REQUIRE(write(fd, data.data(), data.size()) == (ssize_t)data.size());
+    close(fd);
+    return path;
+}
+
+#endif // included_test_fixtures_h_
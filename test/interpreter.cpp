@@ -0,0 +1,320 @@
+#include <test/catch.hpp>
+
+#include <hash.h>
+#include <instance.h>
+
+TEST_CASE("Rewinding restores the environment", "[rewind]") {
+    btc_logf = btc_logf_dummy;
+    VALUE_WARN = false;
+
+    SECTION("Stack, altstack and conditionals") {
+        Instance instance;
+        instance.parse_script("[1 2 3 4 5 OP_TOALTSTACK 3 OP_ROLL OP_IF OP_2DUP OP_ELSE OP_DROP OP_ENDIF OP_FROMALTSTACK OP_2SWAP OP_ROT OP_TUCK OP_NIP OP_DEPTH OP_1SUB OP_PICK]");
+        instance.parse_stack_args({"0x0102", "0x"});
+        REQUIRE(instance.setup_environment());
+
+        std::vector<std::vector<valtype>> stacks, altstacks;
+        std::vector<std::vector<bool>> vfexecs;
+        while (!instance.at_end()) {
+            stacks.push_back(instance.env->stack);
+            altstacks.push_back(instance.env->altstack);
+            vfexecs.push_back(instance.env->vfExec.values());
+            REQUIRE(instance.step());
+        }
+        // the final step only marks the script as done
+        REQUIRE(instance.env->history.size() == stacks.size() - 1);
+        REQUIRE(instance.env->stack == stacks.back());
+        stacks.pop_back();
+        altstacks.pop_back();
+        vfexecs.pop_back();
+
+        while (!stacks.empty()) {
+            REQUIRE(instance.rewind());
+            REQUIRE(instance.env->stack == stacks.back());
+            REQUIRE(instance.env->altstack == altstacks.back());
+            REQUIRE(instance.env->vfExec.values() == vfexecs.back());
+            stacks.pop_back();
+            altstacks.pop_back();
+            vfexecs.pop_back();
+        }
+        REQUIRE(instance.at_start());
+        REQUIRE(!instance.rewind());
+    }
+
+    SECTION("Multisig consumes the entire stack") {
+        Instance instance;
+        instance.parse_script("[OP_1 0x0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c OP_1 OP_CHECKMULTISIG]");
+        instance.parse_stack_args({"0x", "0x"});
+        REQUIRE(instance.setup_environment(STANDARD_SCRIPT_VERIFY_FLAGS & ~SCRIPT_VERIFY_NULLFAIL));
+        std::vector<valtype> initial = instance.env->stack;
+        REQUIRE(instance.step(4));
+        REQUIRE(instance.env->stack.size() == 1);
+        for (int i = 0; i < 4; ++i) REQUIRE(instance.rewind());
+        REQUIRE(instance.env->stack == initial);
+    }
+}
+
+TEST_CASE("Seeking to arbitrary positions", "[seek]") {
+    btc_logf = btc_logf_dummy;
+    VALUE_WARN = false;
+
+    SECTION("Within a single script") {
+        std::string script = "[";
+        for (int i = 0; i < 60; ++i) script += "1 OP_ADD OP_DUP OP_TOALTSTACK ";
+        script += "]";
+        Instance instance;
+        instance.parse_script(script.c_str());
+        instance.parse_stack_args({"0x"});
+        REQUIRE(instance.setup_environment());
+        instance.env->checkpoint_interval = 16;
+
+        std::vector<std::vector<valtype>> stacks, altstacks;
+        while (!instance.at_end()) {
+            stacks.push_back(instance.env->stack);
+            altstacks.push_back(instance.env->altstack);
+            REQUIRE(instance.step());
+        }
+
+        for (int target : {0, 239, 17, 200, 201, 16, 15, 150, 151, 48, 239, 1}) {
+            REQUIRE(instance.seek(target));
+            REQUIRE(instance.env->curr_op_seq == target);
+            REQUIRE(instance.env->stack == stacks[target]);
+            REQUIRE(instance.env->altstack == altstacks[target]);
+            // rewinding after a seek uses the step history
+            if (target > 0) {
+                REQUIRE(instance.rewind());
+                REQUIRE(instance.env->stack == stacks[target - 1]);
+                REQUIRE(instance.env->altstack == altstacks[target - 1]);
+                REQUIRE(instance.step());
+            }
+        }
+        REQUIRE(!instance.seek(500));
+    }
+
+    SECTION("Across the scriptSig/scriptPubKey boundary") {
+        Instance instance;
+        instance.parse_script("[1 2 3]");
+        instance.successor_script = CScript() << OP_ADD << OP_ADD << OP_6 << OP_EQUAL;
+        REQUIRE(instance.setup_environment());
+
+        std::vector<std::vector<valtype>> stacks;
+        while (!instance.at_end()) {
+            stacks.push_back(instance.env->stack);
+            REQUIRE(instance.step());
+        }
+        REQUIRE(instance.env->stack.size() == 1);
+        REQUIRE(instance.env->stack[0] == valtype(1, 1));
+
+        for (int target = (int)stacks.size() - 1; target >= 0; --target) {
+            REQUIRE(instance.seek(target));
+            REQUIRE(instance.env->stack == stacks[target]);
+        }
+        REQUIRE(instance.seek(stacks.size() - 1));
+        REQUIRE(instance.env->stack == stacks.back());
+    }
+}
+
+TEST_CASE("Stepping without history", "[fast]") {
+    btc_logf = btc_logf_dummy;
+    VALUE_WARN = false;
+
+    SECTION("Across the scriptSig/scriptPubKey boundary") {
+        Instance instance;
+        instance.parse_script("[1 2 3]");
+        instance.successor_script = CScript() << OP_ADD << OP_ADD << OP_6 << OP_EQUAL;
+        REQUIRE(instance.setup_environment());
+        instance.env->record_history = false;
+        REQUIRE(instance.step(3));
+        REQUIRE(!instance.rewind());
+        REQUIRE(instance.env->curr_op_seq == 3);
+        REQUIRE(!instance.seek(1));
+        REQUIRE(instance.seek(5));
+        REQUIRE(ContinueScript(*instance.env));
+        REQUIRE(instance.env->stack.size() == 1);
+        REQUIRE(instance.env->stack[0] == valtype(1, 1));
+        REQUIRE(instance.env->history.empty());
+        REQUIRE(instance.env->checkpoints.empty());
+    }
+
+    SECTION("P2SH redeem script") {
+        CScript redeem = CScript() << OP_2 << OP_3 << OP_ADD << OP_5 << OP_EQUAL;
+        CScript script = CScript() << OP_HASH160 << ToByteVector(Hash160(redeem.begin(), redeem.end())) << OP_EQUAL;
+        BaseSignatureChecker checker;
+        for (bool record_history : {true, false}) {
+            std::vector<valtype> stack{valtype(redeem.begin(), redeem.end())};
+            ScriptError serror;
+            InterpreterEnv env(stack, script, STANDARD_SCRIPT_VERIFY_FLAGS, checker, SigVersion::BASE, &serror);
+            env.record_history = record_history;
+            REQUIRE(ContinueScript(env));
+            REQUIRE(serror == SCRIPT_ERR_OK);
+            REQUIRE(env.stack == std::vector<valtype>{valtype(1, 1)});
+            // 3 ops, the switch to the redeem script, and 5 ops
+            REQUIRE(env.curr_op_seq == 9);
+            REQUIRE(env.history.size() == (record_history ? 8 : 0));
+            REQUIRE(env.checkpoints.empty() == !record_history);
+        }
+    }
+}
+
+TEST_CASE("Profiling script execution", "[profile]") {
+    btc_logf = btc_logf_dummy;
+    VALUE_WARN = false;
+
+    Instance instance;
+    instance.parse_script("[1 2 OP_ADD 0x0102 OP_DROP OP_DUP OP_IF 3 OP_ELSE 4 OP_ENDIF OP_DROP 0x 0x0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c OP_CHECKSIG]");
+    instance.parse_stack_args({});
+    REQUIRE(instance.setup_environment());
+    ScriptProfile profile;
+    instance.env->profile = &profile;
+    REQUIRE(ContinueScript(*instance.env));
+
+    REQUIRE(profile.ops[OP_1].count == 1);
+    REQUIRE(profile.ops[OP_ADD].count == 1);
+    REQUIRE(profile.ops[OP_DROP].count == 2);
+    // the push of 0x0102 is opcode 2, which pushes two bytes
+    REQUIRE(profile.ops[2].count == 1);
+    REQUIRE(profile.ops[2].bytes_pushed == 2);
+    // 0x is OP_0, and the pubkey push is opcode 33
+    REQUIRE(profile.ops[OP_0].count == 1);
+    REQUIRE(profile.ops[33].bytes_pushed == 33);
+    // small numbers, results and copies count as pushes too
+    REQUIRE(profile.ops[OP_1].bytes_pushed == 1);
+    REQUIRE(profile.ops[OP_ADD].bytes_pushed == 1);
+    REQUIRE(profile.ops[OP_DUP].bytes_pushed == 1);
+    REQUIRE(profile.ops[OP_DROP].bytes_pushed == 0);
+    // unexecuted branches are stepped over too
+    REQUIRE(profile.ops[OP_4].count == 1);
+    REQUIRE(profile.ops[OP_4].bytes_pushed == 0);
+    REQUIRE(profile.ops[OP_CHECKSIG].count == 1);
+    REQUIRE(profile.ops[OP_CHECKSIG].sig_checks == 1);
+    REQUIRE(profile.ops[OP_ADD].sig_checks == 0);
+    REQUIRE(profile.ToString().find("OP_CHECKSIG") != std::string::npos);
+    REQUIRE(profile.ToJSON().find("\"opcode\": \"OP_ADD\", \"count\": 1") != std::string::npos);
+
+    profile.Reset();
+    REQUIRE(profile.Empty());
+}
+
+TEST_CASE("Stack items reuse popped buffers", "[stackpool]") {
+    btc_logf = btc_logf_dummy;
+    VALUE_WARN = false;
+
+    // stack shuffling ops that copy, move and drop items
+    Instance instance;
+    instance.parse_script("[1 2 3 4 5 6 OP_2ROT OP_2OVER OP_NIP OP_TUCK 5 OP_ROLL 2 OP_PICK OP_3DUP OP_2DUP OP_IFDUP OP_SIZE OP_SHA256 OP_DEPTH OP_DEPTH OP_2DROP]");
+    instance.parse_stack_args({});
+    REQUIRE(instance.setup_environment());
+    REQUIRE(ContinueScript(*instance.env));
+    std::vector<std::string> stack;
+    for (const auto& item : instance.env->stack) stack.push_back(HexStr(item));
+    REQUIRE(stack == std::vector<std::string>{
+        "03", "04", "06", "01", "06", "02", "06", "05", "02", "06", "05", "02", "05", "02", "02",
+        "4bf5122f344554c53bde2ebb8cd2b7e3d1600ad631c385a5d7cce23c7785459a",
+    });
+
+    // the buffers of items popped above are now spare, and are handed back out
+    size_t spare = g_stack_pool.size();
+    REQUIRE(spare > 0);
+    valtype item = g_stack_pool.Take();
+    REQUIRE(item.empty());
+    REQUIRE(item.capacity() > 0);
+    REQUIRE(g_stack_pool.size() == spare - 1);
+    g_stack_pool.Release(std::move(item));
+    REQUIRE(g_stack_pool.size() == spare);
+}
+
+TEST_CASE("Decoding scripts", "[decode]") {
+    // OP_DUP, a direct push of 2 bytes, an OP_PUSHDATA1 push of 3 bytes, OP_0, then a truncated push
+    std::vector<unsigned char> data = ParseHex("7602abcd4c03010203004c05ff");
+    CScript script(data.begin(), data.end());
+    DecodedScript decoded(script);
+    REQUIRE(decoded.IsFor(script));
+    REQUIRE(decoded.size() == 4);
+    REQUIRE(!decoded.Complete());
+    REQUIRE(decoded.End() == 10);
+
+    REQUIRE(decoded[0].opcode == OP_DUP);
+    REQUIRE(decoded[0].push_size == 0);
+    REQUIRE(decoded[1].opcode == 2);
+    REQUIRE(decoded[1].offset == 1);
+    REQUIRE(decoded[1].next == 4);
+    REQUIRE(HexStr(decoded.PushData(decoded[1]), decoded.PushData(decoded[1]) + decoded[1].push_size) == "abcd");
+    REQUIRE(decoded[2].opcode == OP_PUSHDATA1);
+    REQUIRE(decoded[2].push_size == 3);
+    REQUIRE(HexStr(decoded.PushData(decoded[2]), decoded.PushData(decoded[2]) + decoded[2].push_size) == "010203");
+    REQUIRE(decoded[3].opcode == OP_0);
+    REQUIRE(decoded[3].push_size == 0);
+
+    REQUIRE(decoded.Find(0) == 0);
+    REQUIRE(decoded.Find(4) == 2);
+    REQUIRE(decoded.Find(1) == 1);
+    // within an instruction, and at the truncated push
+    REQUIRE(decoded.Find(2) == decoded.size());
+    REQUIRE(decoded.Find(10) == decoded.size());
+
+    decoded.Clear();
+    REQUIRE(!decoded.IsFor(script));
+
+    SECTION("Executing a truncated push fails at it") {
+        btc_logf = btc_logf_dummy;
+        std::vector<std::vector<unsigned char>> stack{{1}};
+        ScriptError error;
+        REQUIRE(!EvalScript(stack, script, 0, BaseSignatureChecker(), SigVersion::BASE, &error));
+        REQUIRE(error == SCRIPT_ERR_BAD_OPCODE);
+        REQUIRE(stack.size() == 5);
+    }
+}
+
+TEST_CASE("Condition stack", "[condition]") {
+    ConditionStack c;
+    REQUIRE(c.empty());
+    REQUIRE(c.all_true());
+    c.push_back(true);
+    c.push_back(false);
+    REQUIRE(!c.all_true());
+    c.push_back(true);
+    c.toggle_top();
+    REQUIRE(c.values() == std::vector<bool>{true, false, false});
+    c.pop_back();
+    c.toggle_top();
+    REQUIRE(c.all_true());
+    c.toggle_top();
+    REQUIRE(!c.all_true());
+    c.pop_back();
+    REQUIRE(c.all_true());
+    REQUIRE(c.size() == 1);
+
+    c.assign({true, true, false, true});
+    REQUIRE(!c.all_true());
+    c.pop_back();
+    REQUIRE(!c.all_true());
+    c.pop_back();
+    REQUIRE(c.all_true());
+}
+
+TEST_CASE("Opcode info", "[opcodeinfo]") {
+    REQUIRE(GetOpcodeInfo(OP_CAT).disabled);
+    REQUIRE(GetOpcodeInfo(OP_RSHIFT).disabled);
+    REQUIRE(!GetOpcodeInfo(OP_ADD).disabled);
+    REQUIRE(!GetOpcodeInfo(OP_16).counted);
+    REQUIRE(!GetOpcodeInfo(OP_RESERVED).counted);
+    REQUIRE(GetOpcodeInfo(OP_NOP).counted);
+    REQUIRE(GetOpcodeInfo(OP_NOTIF).conditional);
+    REQUIRE(!GetOpcodeInfo(OP_VERIFY).conditional);
+    size_t spawns, slays;
+    GetStackFeatures(OP_DUP, spawns, slays);
+    REQUIRE(spawns == 2);
+    REQUIRE(slays == 1);
+    GetStackFeatures(OP_PUSHDATA1, spawns, slays);
+    REQUIRE(spawns == 1);
+    REQUIRE(slays == 0);
+
+    SECTION("Disabled opcodes fail in unexecuted branches") {
+        btc_logf = btc_logf_dummy;
+        std::vector<std::vector<unsigned char>> stack;
+        ScriptError error;
+        CScript script = CScript() << OP_0 << OP_IF << OP_MUL << OP_ENDIF << OP_1;
+        REQUIRE(!EvalScript(stack, script, 0, BaseSignatureChecker(), SigVersion::BASE, &error));
+        REQUIRE(error == SCRIPT_ERR_DISABLED_OPCODE);
+    }
+}
@@ -0,0 +1,98 @@
+#include "catch.hpp"
+#include "fixtures.h"
+
+#include "../batch.h"
+#include "../instance.h"
+#include <script/sigcache.h>
+
+#include <cstdio>
+#include <sys/stat.h>
+
+static uint256 entry_for(int i) {
+    uint256 entry;
+    entry.begin()[0] = i & 0xff;
+    entry.begin()[1] = i >> 8;
+    entry.begin()[31] = i & 0xff;
+    return entry;
+}
+
+TEST_CASE("Signature cache", "[sigcache]") {
+    SECTION("Lookups and eviction") {
+        CSignatureCache cache(160);
+        REQUIRE(!cache.Get(entry_for(1)));
+        cache.Set(entry_for(1));
+        REQUIRE(cache.Get(entry_for(1)));
+        REQUIRE(cache.Hits() == 1);
+        REQUIRE(cache.Misses() == 1);
+
+        // each of the 16 shards holds 10 entries; fill way past that
+        for (int i = 2; i < 1000; ++i) {
+            cache.Set(entry_for(i));
+            // keep entry 1 in use, so it is never the least recently used
+            REQUIRE(cache.Get(entry_for(1)));
+        }
+        REQUIRE(cache.Size() == 160);
+        REQUIRE(!cache.Get(entry_for(2)));
+        REQUIRE(cache.Get(entry_for(999)));
+    }
+
+    SECTION("Saving and loading") {
+        std::string path = write_temp_file({});
+
+        CPubKey pubkey(ParseHex("0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c"));
+        std::vector<unsigned char> sig(ParseHex("3044"));
+        uint256 hash, entry, loaded_entry;
+        {
+            CSignatureCache cache;
+            cache.ComputeEntry(entry, hash, sig, pubkey);
+            cache.Set(entry);
+            REQUIRE(cache.Save(path));
+        }
+        CSignatureCache loaded;
+        REQUIRE(loaded.Load(path));
+        REQUIRE(loaded.Size() == 1);
+        // the salt is restored, so entries are computed the same way
+        loaded.ComputeEntry(loaded_entry, hash, sig, pubkey);
+        REQUIRE(loaded_entry == entry);
+        REQUIRE(loaded.Get(entry));
+
+        // a save that cannot be written leaves the old file in place
+        std::string new_path = path + ".new";
+        REQUIRE(mkdir(new_path.c_str(), 0700) == 0);
+        {
+            CSignatureCache empty;
+            REQUIRE(!empty.Save(path));
+        }
+        rmdir(new_path.c_str());
+        CSignatureCache kept;
+        REQUIRE(kept.Load(path));
+        REQUIRE(kept.Size() == 1);
+        remove(path.c_str());
+
+        CSignatureCache missing;
+        REQUIRE(!missing.Load(path));
+        REQUIRE(missing.Size() == 0);
+    }
+
+    SECTION("Used by signature checkers") {
+        btc_logf = btc_logf_dummy;
+        ECCVerifyHandle evh;
+        InitSignatureCache();
+        BatchRecord record;
+        std::string error;
+        REQUIRE(parse_batch_record(TXHEX " " TXSPK " " TXAMT, record, error));
+        REQUIRE(verify_batch_input(record, 0, STANDARD_SCRIPT_VERIFY_FLAGS) == SCRIPT_ERR_OK);
+        size_t misses = GetSignatureCache()->Misses();
+        REQUIRE(GetSignatureCache()->Hits() == 0);
+        REQUIRE(GetSignatureCache()->Size() == 2);
+        // the second time around, both signatures are found in the cache; the
+        // attempt to match the first signature against the wrong key is not
+        // cached, as only successful verifications are
+        REQUIRE(misses == 3);
+        REQUIRE(verify_batch_input(record, 0, STANDARD_SCRIPT_VERIFY_FLAGS) == SCRIPT_ERR_OK);
+        REQUIRE(GetSignatureCache()->Hits() == 2);
+        REQUIRE(GetSignatureCache()->Misses() == misses + 1);
+        DestroySignatureCache();
+        REQUIRE(!GetSignatureCache());
+    }
+}
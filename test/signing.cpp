@@ -1,4 +1,5 @@
 #include "catch.hpp"
+#include "fixtures.h"
 
 #include "../instance.h"
 
@@ -15,8 +16,6 @@ tx=8.947024:010000000001019086ce64fce1bb086395faf6fac37c73f32ba4ea89330432bf8ee8
 #define STACK1 ""
 #define STACK2 "304402207f874ef00f11dcc9a621acad9354f3fca1bf90c43878f607b7e2d358088487e7022052a01b47b8eef5e1c96a6affdc3dac46fdc11b60612464dc8c5921a852090d2701"
 #define STACK3 "3045022100c56ab2abb17fdf565417228763bc9f2940a6465042fd62fbd9f4c7406345d7f702201cb1a56b45181f8347713627b325ec5df48fc1aee6bdaf937cbb804d7409b10c01"
-#define TXHEX  "010000000001019086ce64fce1bb086395faf6fac37c73f32ba4ea89330432bf8ee8035e9315aa0100000000ffffffff021353b9030000000017a914c3f413d0918853a8e23766678d2e3c2e5c8138bb8725e4973100000000220020701a8d401c84fb13e6baf169d59684e17abd9fa216c8cc5b9fc63d622ff8c58d040047304402207f874ef00f11dcc9a621acad9354f3fca1bf90c43878f607b7e2d358088487e7022052a01b47b8eef5e1c96a6affdc3dac46fdc11b60612464dc8c5921a852090d2701483045022100c56ab2abb17fdf565417228763bc9f2940a6465042fd62fbd9f4c7406345d7f702201cb1a56b45181f8347713627b325ec5df48fc1aee6bdaf937cbb804d7409b10c016952210375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c2103a1b26313f430c4b15bb1fdce663207659d8cac749a0e53d70eff01874496feff2103c96d495bfdd5ba4145e3e046fee45e84a8a48ad05bd8dbb395c011a32cf9f88053ae00000000"
-#define TXAMT  "8.947024"
 
 TEST_CASE("Segwit Multisig Signing", "[signing-segwit-multisig]") {
     btc_logf = btc_logf_dummy;
@@ -24,6 +23,9 @@ TEST_CASE("Segwit Multisig Signing", "[signing-segwit-multisig]") {
     SECTION("Valid inputs") {
         Instance instance;
         instance.parse_transaction(TXAMT ":" TXHEX, true);
+        // sighash midstates are computed once, up front
+        REQUIRE(instance.txdata);
+        REQUIRE(instance.txdata->ready);
 
         instance.parse_script(SCRIPT);
         // script should have 6 entries
@@ -143,3 +145,102 @@ TEST_CASE("Segwit Multisig Signing", "[signing-segwit-multisig]") {
         REQUIRE(ContinueScript(*instance.env));
     }
 }
+
+TEST_CASE("Loading transactions from raw files", "[tx-file]") {
+    btc_logf = btc_logf_dummy;
+
+    Instance hex;
+    REQUIRE(hex.parse_transaction(TXIII, true));
+
+    SECTION("Whole transaction") {
+        std::string path = write_temp_file(ParseHex(TXIII));
+        Instance instance;
+        REQUIRE(instance.load_transaction_file(("0.1,0.002:" + path).c_str()));
+        unlink(path.c_str());
+        REQUIRE(instance.tx->GetHash() == hex.tx->GetHash());
+        REQUIRE(instance.tx->GetWitnessHash() == hex.tx->GetWitnessHash());
+        REQUIRE(instance.sigver == SigVersion::WITNESS_V0);
+        REQUIRE(instance.amounts == std::vector<CAmount>{10000000, 200000});
+
+        // and it can be verified as before
+        REQUIRE(instance.parse_input_transaction(TXIIIIN));
+        REQUIRE(instance.configure_tx_txin());
+        REQUIRE(instance.setup_environment());
+        REQUIRE(ContinueScript(*instance.env));
+    }
+
+    SECTION("Truncated transaction") {
+        std::vector<unsigned char> data = ParseHex(TXIII);
+        data.resize(data.size() - 10);
+        std::string path = write_temp_file(data);
+        Instance instance;
+        REQUIRE(!instance.load_transaction_file(path.c_str()));
+        unlink(path.c_str());
+        REQUIRE(!instance.tx);
+    }
+
+    SECTION("Missing file") {
+        Instance instance;
+        REQUIRE(!instance.load_transaction_file("/nonexistent/tx.bin"));
+    }
+}
+
+TEST_CASE("Signature hash cache", "[sighash-cache]") {
+    SigHashCache cache;
+    CScript scriptCode = CScript() << OP_2 << OP_CHECKMULTISIG;
+    uint256 hash, hash2;
+    hash.SetHex("0102030405060708091011121314151617181920212223242526272829303132");
+
+    REQUIRE(!cache.Load(scriptCode, SIGHASH_ALL, SigVersion::BASE, hash2));
+    cache.Store(scriptCode, SIGHASH_ALL, SigVersion::BASE, hash);
+    REQUIRE(cache.Load(scriptCode, SIGHASH_ALL, SigVersion::BASE, hash2));
+    REQUIRE(hash2 == hash);
+
+    // every part of the key matters
+    REQUIRE(!cache.Load(scriptCode, SIGHASH_NONE, SigVersion::BASE, hash2));
+    REQUIRE(!cache.Load(scriptCode, SIGHASH_ALL, SigVersion::WITNESS_V0, hash2));
+    REQUIRE(!cache.Load(CScript() << OP_3 << OP_CHECKMULTISIG, SIGHASH_ALL, SigVersion::BASE, hash2));
+}
+
+TEST_CASE("Parsed pubkeys", "[parsed-pubkey]") {
+    ECCVerifyHandle evh;
+    CPubKey pubkey(ParseHex("0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c"));
+    CParsedPubKey parsed(pubkey);
+    REQUIRE(parsed.IsValid());
+    REQUIRE(!CParsedPubKey().IsValid());
+    // not on the curve
+    REQUIRE(!CParsedPubKey(CPubKey(ParseHex("030000000000000000000000000000000000000000000000000000000000000007"))).IsValid());
+    // a parsed key gives the same results as the serialized one
+    std::vector<unsigned char> sig = ParseHex(STACK2);
+    sig.pop_back();
+    uint256 hash;
+    REQUIRE(parsed.Verify(hash, sig) == pubkey.Verify(hash, sig));
+    REQUIRE(!parsed.Verify(hash, sig));
+}
+
+TEST_CASE("Parsed pubkey cache", "[parsed-pubkey]") {
+    ECCVerifyHandle evh;
+    btc_logf = btc_logf_dummy;
+    CMutableTransaction tx;
+    CDataStream(ParseHex(TXHEX), SER_NETWORK, PROTOCOL_VERSION) >> tx;
+    std::vector<unsigned char> spk = ParseHex(SCRIPT);
+    CAmount amount = 894702400;
+    uint256 hash = SignatureHash(CScript(spk.begin(), spk.end()), tx, 0, SIGHASH_ALL, amount, SigVersion::WITNESS_V0);
+    std::vector<unsigned char> sig = ParseHex(STACK2);
+    sig.pop_back();
+    // the same x coordinate with the other parity lands in the same cache slot
+    CPubKey pubkey(ParseHex("0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c"));
+    CPubKey twin(ParseHex("0275e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c"));
+    for (int i = 0; i < 2; ++i) {
+        REQUIRE(pubkey.Verify(hash, sig));
+        REQUIRE(CParsedPubKey(pubkey).Verify(hash, sig));
+        REQUIRE(twin.IsFullyValid());
+        REQUIRE(!twin.Verify(hash, sig));
+        REQUIRE(!CParsedPubKey(twin).Verify(hash, sig));
+    }
+    CPubKey uncompressed = pubkey;
+    REQUIRE(uncompressed.Decompress());
+    REQUIRE(uncompressed.size() == 65);
+    REQUIRE(uncompressed.Verify(hash, sig));
+    REQUIRE(!CPubKey(ParseHex("030000000000000000000000000000000000000000000000000000000000000007")).IsFullyValid());
+}
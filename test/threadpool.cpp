@@ -0,0 +1,29 @@
+#include "catch.hpp"
+
+#include "../threadpool.h"
+
+TEST_CASE("Work stealing pool", "[threadpool]") {
+    SECTION("Every task runs exactly once") {
+        for (size_t size : {1, 2, 3, 8}) {
+            WorkStealingPool pool(size);
+            REQUIRE(pool.size() == size);
+            for (size_t count : {0, 1, 7, 1000}) {
+                std::vector<std::atomic<int>> hits(count);
+                for (auto& h : hits) h = 0;
+                pool.run(count, [&](size_t i) { ++hits[i]; });
+                for (size_t i = 0; i < count; ++i) REQUIRE(hits[i] == 1);
+            }
+        }
+    }
+
+    SECTION("Uneven tasks are stolen") {
+        WorkStealingPool pool(4);
+        std::atomic<size_t> sum(0);
+        // all the expensive tasks end up in the first worker's slice
+        pool.run(400, [&](size_t i) {
+            if (i < 100) std::this_thread::sleep_for(std::chrono::microseconds(200));
+            sum += i;
+        });
+        REQUIRE(sum == 400 * 399 / 2);
+    }
+}
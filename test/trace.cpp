@@ -0,0 +1,72 @@
+#include "catch.hpp"
+#include "fixtures.h"
+
+#include "../instance.h"
+#include "../trace.h"
+
+/** Run script, tracing it into a temporary file, and return what was written. */
+static std::string trace_script(const char* script, TraceFormat format, bool expect_success = true) {
+    std::string path = write_temp_file({});
+    FILE* file = fopen(path.c_str(), "wb");
+    REQUIRE(file);
+
+    Instance instance;
+    instance.parse_script(script);
+    instance.parse_stack_args({});
+    REQUIRE(instance.setup_environment());
+    ScriptTraceWriter trace(file, format);
+    instance.env->tracer = &trace;
+    REQUIRE(ContinueScript(*instance.env) == expect_success);
+    REQUIRE(trace.close());
+
+    std::string data;
+    FILE* in = fopen(path.c_str(), "rb");
+    REQUIRE(in);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) data.append(buf, n);
+    fclose(in);
+    unlink(path.c_str());
+    return data;
+}
+
+TEST_CASE("Tracing script execution", "[trace]") {
+    btc_logf = btc_logf_dummy;
+    VALUE_WARN = false;
+
+    SECTION("JSONL") {
+        std::string data = trace_script("[1 2 OP_SWAP OP_TOALTSTACK OP_DUP OP_FROMALTSTACK 1 OP_IF OP_ENDIF]", TraceFormat::JSONL);
+        std::vector<std::string> lines;
+        size_t pos = 0, end;
+        while ((end = data.find('\n', pos)) != std::string::npos) {
+            lines.push_back(data.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        REQUIRE(pos == data.size());
+        REQUIRE(lines.size() == 9);
+        REQUIRE(lines[0] == "{\"step\":0,\"opcode\":\"1\",\"pc\":0,\"ok\":true,\"pop\":0,\"push\":[\"01\"],\"altpop\":0,\"altpush\":[],\"exec_depth\":0,\"nopcount\":0}");
+        REQUIRE(lines[2] == "{\"step\":2,\"opcode\":\"OP_SWAP\",\"pc\":2,\"ok\":true,\"pop\":2,\"push\":[\"02\",\"01\"],\"altpop\":0,\"altpush\":[],\"exec_depth\":0,\"nopcount\":1}");
+        REQUIRE(lines[3] == "{\"step\":3,\"opcode\":\"OP_TOALTSTACK\",\"pc\":3,\"ok\":true,\"pop\":1,\"push\":[],\"altpop\":0,\"altpush\":[\"01\"],\"exec_depth\":0,\"nopcount\":2}");
+        // the duplicated item is left in place, so only the copy is pushed
+        REQUIRE(lines[4] == "{\"step\":4,\"opcode\":\"OP_DUP\",\"pc\":4,\"ok\":true,\"pop\":0,\"push\":[\"02\"],\"altpop\":0,\"altpush\":[],\"exec_depth\":0,\"nopcount\":3}");
+        REQUIRE(lines[5] == "{\"step\":5,\"opcode\":\"OP_FROMALTSTACK\",\"pc\":5,\"ok\":true,\"pop\":0,\"push\":[\"01\"],\"altpop\":1,\"altpush\":[],\"exec_depth\":0,\"nopcount\":4}");
+        REQUIRE(lines[7].find("\"opcode\":\"OP_IF\"") != std::string::npos);
+        REQUIRE(lines[7].find("\"exec_depth\":1") != std::string::npos);
+        REQUIRE(lines[8].find("\"exec_depth\":0") != std::string::npos);
+    }
+
+    SECTION("Failing steps are recorded") {
+        std::string data = trace_script("[1 OP_VERIFY OP_VERIFY]", TraceFormat::JSONL, false);
+        REQUIRE(data.find("\"step\":2,\"opcode\":\"OP_VERIFY\",\"pc\":2,\"ok\":false") != std::string::npos);
+    }
+
+    SECTION("Binary") {
+        std::string data = trace_script("[0x0102 OP_DUP]", TraceFormat::BINARY);
+        std::string expected = std::string("btcdebtr\x01", 9)
+            // step 0: push of 2 bytes at pc 0, pushing 0102
+            + std::string("\x00\x02\x00\x01\x00\x01\x02\x01\x02\x00\x00\x00\x00", 13)
+            // step 1: OP_DUP at pc 3, pushing a copy of 0102
+            + std::string("\x01\x76\x03\x01\x00\x01\x02\x01\x02\x00\x00\x00\x01", 13);
+        REQUIRE(data == expected);
+    }
+}
@@ -0,0 +1,172 @@
+#include "catch.hpp"
+#include "fixtures.h"
+
+#include "../batch.h"
+#include "../instance.h"
+#include "../tx_file.h"
+
+static void append_tx(std::vector<unsigned char>& data, const CMutableTransaction& mtx) {
+    CVectorWriter(SER_DISK, 0, data, data.size(), mtx);
+}
+
+/** Append a block file record holding the given transactions (under a blank header). */
+static void append_block(std::vector<unsigned char>& data, const std::vector<CMutableTransaction>& txs) {
+    std::vector<unsigned char> block(80, 0);
+    CVectorWriter writer(SER_DISK, 0, block, block.size());
+    WriteCompactSize(writer, txs.size());
+    for (const auto& mtx : txs) append_tx(block, mtx);
+    const unsigned char header[] = {0xf9, 0xbe, 0xb4, 0xd9, (unsigned char)block.size(), (unsigned char)(block.size() >> 8), 0, 0};
+    data.insert(data.end(), header, header + sizeof(header));
+    data.insert(data.end(), block.begin(), block.end());
+}
+
+TEST_CASE("Reading transaction files", "[txfile]") {
+    btc_logf = btc_logf_dummy;
+    ECCVerifyHandle evh;
+
+    // a coinbase paying to OP_1 and OP_0, and a transaction spending both
+    // of those outputs, and one not in the file
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_0 << OP_0;
+    coinbase.vout.resize(2);
+    coinbase.vout[0].scriptPubKey = CScript() << OP_1;
+    coinbase.vout[0].nValue = 50 * COIN;
+    coinbase.vout[1].scriptPubKey = CScript() << OP_0;
+    coinbase.vout[1].nValue = COIN;
+    const uint256 coinbase_hash = coinbase.GetHash();
+
+    CMutableTransaction spend;
+    spend.vin.resize(3);
+    spend.vin[0].prevout = COutPoint(coinbase_hash, 0);
+    spend.vin[1].prevout = COutPoint(coinbase_hash, 1);
+    spend.vin[2].prevout = COutPoint(uint256S("0101010101010101010101010101010101010101010101010101010101010101"), 0);
+    spend.vout.resize(1);
+    spend.vout[0].scriptPubKey = CScript() << OP_1;
+    spend.vout[0].nValue = 51 * COIN;
+    const uint256 spend_hash = spend.GetHash();
+
+    SECTION("Raw transactions") {
+        std::vector<unsigned char> data;
+        append_tx(data, coinbase);
+        size_t second = data.size();
+        append_tx(data, spend);
+        std::string path = write_temp_file(data);
+
+        TransactionFileReader reader;
+        std::string error;
+        REQUIRE(reader.open(path, error));
+        unlink(path.c_str());
+        REQUIRE(reader.get_format() == TransactionFileReader::Format::RAW);
+
+        RawTransaction rtx;
+        REQUIRE(reader.next(rtx, error));
+        REQUIRE(rtx.offset == 0);
+        REQUIRE(rtx.data.size() == (ptrdiff_t)second);
+        REQUIRE(rtx.tx->GetHash() == coinbase_hash);
+        REQUIRE(reader.next(rtx, error));
+        REQUIRE(rtx.offset == second);
+        REQUIRE(rtx.data.size() == (ptrdiff_t)(data.size() - second));
+        REQUIRE(rtx.tx->GetHash() == spend_hash);
+        REQUIRE(!reader.next(rtx, error));
+        REQUIRE(error == "");
+
+        REQUIRE(reader.read_at(second)->GetHash() == spend_hash);
+    }
+
+    SECTION("Block files") {
+        std::vector<unsigned char> data;
+        append_block(data, {coinbase});
+        append_block(data, {spend});
+        // preallocated space
+        data.resize(data.size() + 100, 0);
+        std::string path = write_temp_file(data);
+
+        TransactionFileReader reader;
+        std::string error;
+        REQUIRE(reader.open(path, error));
+        unlink(path.c_str());
+        REQUIRE(reader.get_format() == TransactionFileReader::Format::BLOCKS);
+
+        RawTransaction rtx;
+        REQUIRE(reader.next(rtx, error));
+        // after the magic, size, header and transaction count
+        REQUIRE(rtx.offset == 89);
+        REQUIRE(rtx.tx->GetHash() == coinbase_hash);
+        REQUIRE(reader.next(rtx, error));
+        REQUIRE(rtx.tx->GetHash() == spend_hash);
+        REQUIRE(reader.read_at(rtx.offset)->GetHash() == spend_hash);
+        REQUIRE(!reader.next(rtx, error));
+        REQUIRE(error == "");
+    }
+
+    SECTION("Malformed files") {
+        std::vector<unsigned char> data;
+        append_block(data, {coinbase, spend});
+        // cut off the second transaction
+        data.resize(data.size() - 5);
+        data[4] -= 5;
+        std::string path = write_temp_file(data);
+
+        TransactionFileReader reader;
+        std::string error;
+        REQUIRE(reader.open(path, error));
+        unlink(path.c_str());
+        RawTransaction rtx;
+        REQUIRE(reader.next(rtx, error));
+        REQUIRE(!reader.next(rtx, error));
+        REQUIRE(error.find("failed to deserialize transaction at offset") == 0);
+
+        REQUIRE(!reader.open("/nonexistent/blk00000.dat", error));
+    }
+
+    SECTION("Scanning") {
+        std::vector<unsigned char> data;
+        append_block(data, {coinbase, spend});
+        std::string path = write_temp_file(data);
+
+        for (size_t threads : {1, 4}) {
+            TransactionFileReader reader;
+            std::string error;
+            REQUIRE(reader.open(path, error));
+            FILE* out = tmpfile();
+            BatchStats stats = run_scan(reader, out, STANDARD_SCRIPT_VERIFY_FLAGS, threads);
+            REQUIRE(stats.records == 2);
+            REQUIRE(stats.inputs == 2);
+            REQUIRE(stats.failures == 1);
+            REQUIRE(stats.unknown_prevouts == 1);
+            REQUIRE(stats.invalid_records == 0);
+
+            rewind(out);
+            char buf[256];
+            REQUIRE(fgets(buf, sizeof(buf), out));
+            REQUIRE(std::string(buf) == spend_hash.ToString() + ":0 ok\n");
+            REQUIRE(fgets(buf, sizeof(buf), out));
+            REQUIRE(std::string(buf) == spend_hash.ToString() + ":1 error: Script evaluated without error but finished with a false/empty top stack element\n");
+            REQUIRE(!fgets(buf, sizeof(buf), out));
+            fclose(out);
+        }
+        unlink(path.c_str());
+    }
+
+    SECTION("Outputs spent before they appear are not resolved") {
+        std::vector<unsigned char> data;
+        append_tx(data, spend);
+        append_tx(data, coinbase);
+        std::string path = write_temp_file(data);
+
+        TransactionFileReader reader;
+        std::string error;
+        REQUIRE(reader.open(path, error));
+        unlink(path.c_str());
+        FILE* out = tmpfile();
+        BatchStats stats = run_scan(reader, out, STANDARD_SCRIPT_VERIFY_FLAGS);
+        REQUIRE(stats.records == 2);
+        REQUIRE(stats.inputs == 0);
+        REQUIRE(stats.unknown_prevouts == 3);
+        rewind(out);
+        char buf[256];
+        REQUIRE(!fgets(buf, sizeof(buf), out));
+        fclose(out);
+    }
+}
@@ -251,3 +251,20 @@ TEST_CASE("Addresses and scriptpubkeys (legacy)", "[addr-spk]") {
         REQUIRE(x.str == address);
     }
 }
+
+TEST_CASE("Batched HASH160 of values", "[hash160]") {
+    std::vector<Value> values;
+    values.emplace_back("0x0375e00eb72e29da82b89367947f29ef34afb75e8654f6ea368e0acdfd92976b7c");
+    values.emplace_back("\"hello\"");
+    values.emplace_back((int64_t)1000);
+    values.emplace_back("[OP_DUP OP_HASH160]");
+    for (int i = 0; i < 9; ++i) values.emplace_back(std::vector<uint8_t>(i * 17, (uint8_t)i));
+    std::vector<Value> expected = values;
+    for (Value& v : expected) v.do_hash160();
+    Value::do_hash160(values);
+    REQUIRE(values.size() == expected.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        REQUIRE(values[i].type == Value::T_DATA);
+        REQUIRE(values[i].data == expected[i].data);
+    }
+}
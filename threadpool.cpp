@@ -0,0 +1,97 @@
+#include <threadpool.h>
+
+WorkStealingPool::WorkStealingPool(size_t size)
+: current(nullptr)
+, generation(0)
+, active(0)
+, stopping(false)
+, remaining(0)
+{
+    if (size < 1) size = 1;
+    for (size_t i = 0; i < size; ++i) queues.emplace_back(new TaskQueue());
+    for (size_t i = 1; i < size; ++i) threads.emplace_back(&WorkStealingPool::thread_main, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv_work.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+bool WorkStealingPool::next_task(size_t worker, size_t& task) {
+    // take from the front of our own queue ...
+    {
+        TaskQueue& q = *queues[worker];
+        std::unique_lock<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+    // ... and steal from the back of someone else's
+    for (size_t i = 1; i < queues.size(); ++i) {
+        TaskQueue& q = *queues[(worker + i) % queues.size()];
+        std::unique_lock<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::work(size_t worker) {
+    size_t task;
+    while (next_task(worker, task)) {
+        (*current)(task);
+        --remaining;
+    }
+}
+
+void WorkStealingPool::thread_main(size_t worker) {
+    size_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv_work.wait(lock, [&]{ return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            ++active;
+        }
+        work(worker);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            --active;
+        }
+        cv_done.notify_all();
+    }
+}
+
+void WorkStealingPool::run(size_t count, const std::function<void(size_t)>& fn) {
+    if (count == 0) return;
+    const size_t n = queues.size();
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // a worker which woke up late for the previous batch may still be
+        // looking for tasks; let it go back to sleep before handing out more
+        cv_done.wait(lock, [&]{ return active == 0; });
+        current = &fn;
+        remaining = count;
+        for (size_t i = 0; i < n; ++i) {
+            TaskQueue& q = *queues[i];
+            std::unique_lock<std::mutex> qlock(q.mutex);
+            for (size_t task = count * i / n; task < count * (i + 1) / n; ++task) q.tasks.push_back(task);
+        }
+        ++generation;
+    }
+    cv_work.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    cv_done.wait(lock, [&]{ return remaining == 0 && active == 0; });
+    current = nullptr;
+}
@@ -0,0 +1,61 @@
+#ifndef included_threadpool_h_
+#define included_threadpool_h_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed size pool of worker threads which runs batches of independent
+ * tasks. Each worker has its own queue of task indices, initially holding a
+ * contiguous slice of the batch; a worker which runs out of tasks steals
+ * from the other end of another worker's queue, so an uneven distribution
+ * of work (e.g. a single transaction with many multisig inputs) does not
+ * leave the other workers idle.
+ *
+ * The thread calling run() takes part as one of the workers, so a pool of
+ * size 1 runs everything inline, without spawning any threads.
+ */
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(size_t size);
+    ~WorkStealingPool();
+
+    size_t size() const { return queues.size(); }
+
+    /**
+     * Call fn(i) for every i in [0, count), and wait for all of the calls
+     * to complete. fn must be safe to call concurrently from multiple
+     * threads.
+     */
+    void run(size_t count, const std::function<void(size_t)>& fn);
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+    const std::function<void(size_t)>* current;
+    size_t generation;
+    size_t active;
+    bool stopping;
+    std::atomic<size_t> remaining;
+
+    bool next_task(size_t worker, size_t& task);
+    void work(size_t worker);
+    void thread_main(size_t worker);
+};
+
+#endif // included_threadpool_h_
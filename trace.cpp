@@ -0,0 +1,185 @@
+#include <trace.h>
+
+#include <debugger/interpreter.h>
+#include <tinyformat.h>
+#include <utilstrencodings.h>
+
+#include <algorithm>
+
+AsyncFileWriter::AsyncFileWriter(FILE* file_in)
+: file(file_in)
+, has_pending(false)
+, stopping(false)
+, failed(false)
+{
+    buffer.reserve(BUFFER_SIZE + 4096);
+    thread = std::thread(&AsyncFileWriter::thread_main, this);
+}
+
+bool AsyncFileWriter::close()
+{
+    if (!file) return !failed;
+    if (!buffer.empty()) submit();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    thread.join();
+    if (fclose(file)) failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+void AsyncFileWriter::submit()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return !has_pending; });
+    pending.swap(buffer);
+    has_pending = true;
+    lock.unlock();
+    cv.notify_all();
+    buffer.clear();
+}
+
+void AsyncFileWriter::thread_main()
+{
+    std::string data;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        cv.wait(lock, [this] { return has_pending || stopping; });
+        if (!has_pending) break;
+        data.swap(pending);
+        has_pending = false;
+        lock.unlock();
+        // let the producer refill while this one is written
+        cv.notify_all();
+        bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+        data.clear();
+        lock.lock();
+        if (!ok) failed = true;
+    }
+    if (fflush(file)) failed = true;
+}
+
+namespace {
+
+void append_compact_size(std::string& s, uint64_t n)
+{
+    unsigned char buf[9];
+    if (n < 253) {
+        buf[0] = n;
+        s.append((const char*)buf, 1);
+    } else if (n <= 0xffff) {
+        buf[0] = 253;
+        buf[1] = n;
+        buf[2] = n >> 8;
+        s.append((const char*)buf, 3);
+    } else if (n <= 0xffffffff) {
+        buf[0] = 254;
+        for (int i = 0; i < 4; ++i) buf[1 + i] = n >> (8 * i);
+        s.append((const char*)buf, 5);
+    } else {
+        buf[0] = 255;
+        for (int i = 0; i < 8; ++i) buf[1 + i] = n >> (8 * i);
+        s.append((const char*)buf, 9);
+    }
+}
+
+/**
+ * Find how a stack changed, given its size and the top items (which the
+ * step could touch) from before. Returns the number of items popped, and
+ * sets first_pushed to the index in stack of the first item pushed.
+ */
+size_t stack_delta(const stack_type& stack, size_t size_before, const stack_type& top_before, size_t& first_pushed)
+{
+    size_t base = size_before - top_before.size();
+    if (stack.size() < base) {
+        // popped below what was captured (does not happen, unless the touch depth was wrong)
+        first_pushed = stack.size();
+        return size_before - stack.size();
+    }
+    size_t kept = 0;
+    while (kept < top_before.size() && base + kept < stack.size() && stack[base + kept] == top_before[kept]) ++kept;
+    first_pushed = base + kept;
+    return size_before - first_pushed;
+}
+
+void append_json_items(std::string& s, const stack_type& stack, size_t first)
+{
+    s += '[';
+    for (size_t i = first; i < stack.size(); ++i) {
+        if (i > first) s += ',';
+        s += '"';
+        s += HexStr(stack[i]);
+        s += '"';
+    }
+    s += ']';
+}
+
+void append_binary_items(std::string& s, const stack_type& stack, size_t first)
+{
+    append_compact_size(s, stack.size() - first);
+    for (size_t i = first; i < stack.size(); ++i) {
+        append_compact_size(s, stack[i].size());
+        s.append((const char*)stack[i].data(), stack[i].size());
+    }
+}
+
+} // namespace
+
+ScriptTraceWriter::ScriptTraceWriter(FILE* file, TraceFormat format_in)
+: out(file)
+, format(format_in)
+, step(0)
+, opcode(OP_INVALIDOPCODE)
+, pc_offset(0)
+, stack_size(0)
+, altstack_size(0)
+{
+    if (format == TraceFormat::BINARY) out.write("btcdebtr\x01", 9);
+}
+
+void ScriptTraceWriter::BeginStep(const ScriptExecutionEnvironment& env, const CScript& script, CScriptIter pc)
+{
+    // StepScript has decoded script by the time it calls this
+    size_t index = env.decoded.Find(pc - script.begin());
+    opcode = index < env.decoded.size() ? env.decoded[index].opcode : OP_INVALIDOPCODE;
+    pc_offset = pc - script.begin();
+    stack_size = env.stack.size();
+    altstack_size = env.altstack.size();
+    size_t depth = std::min(GetStackTouchDepth(opcode, env.stack), stack_size);
+    stack_top.assign(env.stack.end() - depth, env.stack.end());
+    size_t altdepth = std::min<size_t>(opcode == OP_FROMALTSTACK ? 1 : 0, altstack_size);
+    altstack_top.assign(env.altstack.end() - altdepth, env.altstack.end());
+}
+
+void ScriptTraceWriter::EndStep(const ScriptExecutionEnvironment& env, bool success)
+{
+    size_t first_pushed, alt_first_pushed;
+    size_t popped = stack_delta(env.stack, stack_size, stack_top, first_pushed);
+    size_t alt_popped = stack_delta(env.altstack, altstack_size, altstack_top, alt_first_pushed);
+
+    record.clear();
+    if (format == TraceFormat::JSONL) {
+        record += strprintf("{\"step\":%u,\"opcode\":\"%s\",\"pc\":%u,\"ok\":%s,\"pop\":%u,\"push\":",
+                            step, GetOpName(opcode), pc_offset, success ? "true" : "false", popped);
+        append_json_items(record, env.stack, first_pushed);
+        record += strprintf(",\"altpop\":%u,\"altpush\":", alt_popped);
+        append_json_items(record, env.altstack, alt_first_pushed);
+        record += strprintf(",\"exec_depth\":%u,\"nopcount\":%d}\n", env.vfExec.size(), env.nOpCount);
+    } else {
+        append_compact_size(record, step);
+        record += (char)opcode;
+        append_compact_size(record, pc_offset);
+        record += (char)success;
+        append_compact_size(record, popped);
+        append_binary_items(record, env.stack, first_pushed);
+        append_compact_size(record, alt_popped);
+        append_binary_items(record, env.altstack, alt_first_pushed);
+        append_compact_size(record, env.vfExec.size());
+        append_compact_size(record, env.nOpCount);
+    }
+    out.write(record);
+    ++step;
+}
@@ -0,0 +1,105 @@
+#ifndef included_trace_h_
+#define included_trace_h_
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <script/interpreter.h>
+
+/**
+ * Writes to a file from a background thread. Data is gathered in a buffer,
+ * which is handed over to the thread once it fills up; at most one further
+ * buffer is queued, so a slow disk eventually throttles the writer instead
+ * of growing memory use.
+ */
+class AsyncFileWriter {
+public:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    explicit AsyncFileWriter(FILE* file);
+    ~AsyncFileWriter() { close(); }
+
+    /**
+     * Write what remains, wait for the thread and close the file. Returns
+     * false if any of the writes failed.
+     */
+    bool close();
+
+    void write(const char* data, size_t len)
+    {
+        buffer.append(data, len);
+        if (buffer.size() >= BUFFER_SIZE) submit();
+    }
+    void write(const std::string& data) { write(data.data(), data.size()); }
+
+private:
+    FILE* file;
+    std::string buffer;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string pending;
+    bool has_pending;
+    bool stopping;
+    bool failed;
+    std::thread thread;
+
+    void submit();
+    void thread_main();
+};
+
+enum class TraceFormat {
+    JSONL,
+    BINARY,
+};
+
+/**
+ * Records every step of a script execution to a file, without keeping any
+ * of it in memory. Each step is described by its index, opcode, the offset
+ * of the instruction in the script, whether it succeeded, what it did to
+ * the stack and altstack, the resulting vfExec depth and the op count.
+ *
+ * A stack delta is given as the number of items popped off the top,
+ * followed by the items pushed in their place (bottom first); items that
+ * were left as they were are not included.
+ *
+ * In JSONL format, each step is a line of the form
+ *
+ *     {"step":3,"opcode":"OP_DUP","pc":5,"ok":true,"pop":0,"push":["02ab"],"altpop":0,"altpush":[],"exec_depth":0,"nopcount":1}
+ *
+ * The binary format starts with the 8 byte magic "btcdebtr" and a version
+ * byte (1), followed by one record per step, consisting of the step index
+ * (CompactSize), opcode (1 byte), pc offset (CompactSize), ok (1 byte), the
+ * stack delta: popped count (CompactSize), pushed count (CompactSize) and
+ * each pushed item (CompactSize length and data), the altstack delta in the
+ * same form, the vfExec depth (CompactSize) and the op count (CompactSize).
+ */
+class ScriptTraceWriter : public ScriptTracer {
+public:
+    ScriptTraceWriter(FILE* file, TraceFormat format);
+
+    void BeginStep(const ScriptExecutionEnvironment& env, const CScript& script, CScriptIter pc) override;
+    void EndStep(const ScriptExecutionEnvironment& env, bool success) override;
+
+    /** Finish writing the trace; returns false if it could not be written in full. */
+    bool close() { return out.close(); }
+
+private:
+    AsyncFileWriter out;
+    const TraceFormat format;
+    uint64_t step;
+
+    // state captured by BeginStep
+    opcodetype opcode;
+    size_t pc_offset;
+    size_t stack_size, altstack_size;
+    std::vector<std::vector<unsigned char>> stack_top, altstack_top;
+
+    std::string record;
+};
+
+#endif // included_trace_h_
@@ -0,0 +1,100 @@
+#include <tx_file.h>
+
+#include <streams.h>
+#include <tinyformat.h>
+
+#include <string.h>
+
+namespace {
+
+/** Network magics, as found at the start of each block in a block file. */
+const unsigned char BLOCK_MAGICS[][4] = {
+    {0xf9, 0xbe, 0xb4, 0xd9}, // mainnet
+    {0x0b, 0x11, 0x09, 0x07}, // testnet3
+    {0xfa, 0xbf, 0xb5, 0xda}, // regtest
+};
+
+const size_t BLOCK_HEADER_SIZE = 80;
+
+bool is_block_magic(const unsigned char* p)
+{
+    for (const auto& magic : BLOCK_MAGICS) {
+        if (!memcmp(p, magic, 4)) return true;
+    }
+    return false;
+}
+
+/** Deserialize the transaction at offset in data, setting end to the offset following it. */
+CTransactionRef read_transaction(Span<const unsigned char> data, size_t offset, size_t& end)
+{
+    SpanReader reader(SER_DISK, 0, Span<const unsigned char>(data.data() + offset, data.size() - offset));
+    CMutableTransaction mtx;
+    UnserializeTransaction(mtx, reader);
+    end = offset + reader.tell();
+    return MakeTransactionRef(std::move(mtx));
+}
+
+} // namespace
+
+bool TransactionFileReader::open(const std::string& path, std::string& error)
+{
+    if (!file.open(path, error)) return false;
+    format = file.size() >= 8 && is_block_magic(file.span().data()) ? Format::BLOCKS : Format::RAW;
+    pos = block_end = 0;
+    block_txs = 0;
+    return true;
+}
+
+bool TransactionFileReader::next(RawTransaction& rtx, std::string& error)
+{
+    error.clear();
+    const unsigned char* data = file.span().data();
+    size_t end = file.size();
+    try {
+        if (format == Format::BLOCKS) {
+            while (block_txs == 0) {
+                pos = block_end;
+                if (file.size() - pos < 8 || !memcmp(data + pos, "\0\0\0\0", 4)) {
+                    // end of file, or of the data in a preallocated file
+                    return false;
+                }
+                if (!is_block_magic(data + pos)) {
+                    error = strprintf("unknown network magic at offset %u", pos);
+                    return false;
+                }
+                const unsigned char* p = data + pos + 4;
+                uint32_t size = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+                if (size < BLOCK_HEADER_SIZE || size > file.size() - pos - 8) {
+                    error = strprintf("block at offset %u is truncated", pos);
+                    return false;
+                }
+                pos += 8;
+                block_end = pos + size;
+                SpanReader reader(SER_DISK, 0, Span<const unsigned char>(data + pos, size));
+                reader.ignore(BLOCK_HEADER_SIZE);
+                block_txs = ReadCompactSize(reader);
+                pos += reader.tell();
+            }
+            // transactions may not run past the end of their block
+            end = block_end;
+            --block_txs;
+        } else if (pos == file.size()) {
+            return false;
+        }
+        size_t tx_end;
+        rtx.tx = read_transaction(Span<const unsigned char>(data, end), pos, tx_end);
+        rtx.offset = pos;
+        rtx.data = Span<const unsigned char>(data + pos, tx_end - pos);
+        pos = tx_end;
+        return true;
+    } catch (const std::exception& ex) {
+        error = strprintf("failed to deserialize transaction at offset %u: %s", pos, ex.what());
+        return false;
+    }
+}
+
+CTransactionRef TransactionFileReader::read_at(size_t offset) const
+{
+    size_t end;
+    return read_transaction(file.span(), offset, end);
+}
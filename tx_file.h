@@ -0,0 +1,66 @@
+#ifndef included_tx_file_h_
+#define included_tx_file_h_
+
+#include <string>
+
+#include <mapped_file.h>
+#include <primitives/transaction.h>
+#include <span.h>
+
+/** A transaction read from a TransactionFileReader. */
+struct RawTransaction {
+    size_t offset;                    ///< where the transaction starts in the file
+    Span<const unsigned char> data;   ///< its serialization, pointing into the mapping
+    CTransactionRef tx;
+};
+
+/**
+ * Reads the transactions in a file one at a time, out of a memory mapping
+ * of it, so that files much larger than the available memory can be gone
+ * through. Two formats are recognized, based on how the file starts:
+ *
+ * - block files as written by Bitcoin Core (blk*.dat): a sequence of
+ *   records, each made up of the network magic (mainnet, testnet or
+ *   regtest), the size of the block (4 bytes, little endian) and the block
+ *   itself; zeros at the end of the file (where Core preallocates space)
+ *   are skipped
+ * - anything else is taken to be raw transactions, back to back
+ */
+class TransactionFileReader {
+public:
+    enum class Format {
+        RAW,
+        BLOCKS,
+    };
+
+    TransactionFileReader() : format(Format::RAW), pos(0), block_end(0), block_txs(0) {}
+
+    /** Map the file at path. On failure, error is set and false is returned. */
+    bool open(const std::string& path, std::string& error);
+
+    Format get_format() const { return format; }
+    size_t size() const { return file.size(); }
+
+    /**
+     * Read the next transaction into rtx. Returns false once the end of the
+     * file is reached, or if the file is malformed, in which case error is
+     * set (and left empty otherwise).
+     */
+    bool next(RawTransaction& rtx, std::string& error);
+
+    /**
+     * Parse the transaction at the given offset again, as returned in an
+     * earlier RawTransaction. Safe to call concurrently with itself (but
+     * not with open).
+     */
+    CTransactionRef read_at(size_t offset) const;
+
+private:
+    MappedFile file;
+    Format format;
+    size_t pos;          ///< offset of the next thing to read
+    size_t block_end;    ///< (BLOCKS) end of the current block
+    uint64_t block_txs;  ///< (BLOCKS) transactions left in the current block
+};
+
+#endif // included_tx_file_h_
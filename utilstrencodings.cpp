@@ -104,6 +104,17 @@ std::vector<unsigned char> ParseHex(const std::string& str)
     return ParseHex(str.c_str());
 }
 
+bool DecodeHex(const char* psz, size_t len, unsigned char* out)
+{
+    for (size_t i = 0; i < len / 2; ++i) {
+        signed char hi = HexDigit(psz[2 * i]);
+        signed char lo = HexDigit(psz[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = (hi << 4) | lo;
+    }
+    return true;
+}
+
 void SplitHostPort(std::string in, int &portOut, std::string &hostOut) {
     size_t colon = in.find_last_of(':');
     // if a : is found, and it either follows a [...], or no other : is in the string, treat it as port separator
@@ -37,6 +37,10 @@ enum SafeChars
 std::string SanitizeString(const std::string& str, int rule = SAFE_CHARS_DEFAULT);
 std::vector<unsigned char> ParseHex(const char* psz);
 std::vector<unsigned char> ParseHex(const std::string& str);
+/* Decode the len / 2 bytes of hex at psz into out, which must have room for
+ * them. Unlike ParseHex, whitespace is not skipped, and nothing is
+ * allocated. Returns false if a non-hex character is found. */
+bool DecodeHex(const char* psz, size_t len, unsigned char* out);
 signed char HexDigit(char c);
 /* Returns true if each character in str is a hex character, and has an even
  * number of hex digits.*/
@@ -5,6 +5,7 @@
 #include <support/allocators/secure.h>
 
 #include <arith_uint256.h>
+#include <hash.h>
 
 static secp256k1_context* secp256k1_context_sign = nullptr;
 
@@ -12,6 +13,21 @@ void ECC_Start();
 
 #define abort(msg...) do { fprintf(stderr, msg); return; } while (0)
 
+void Value::do_hash160(std::vector<Value>& values) {
+    std::vector<Span<const unsigned char>> inputs;
+    for (Value& v : values) {
+        v.data_value();
+        v.type = T_DATA;
+        inputs.emplace_back(v.data.data(), v.data.size());
+    }
+    std::vector<unsigned char> hashes(CHash160::OUTPUT_SIZE * values.size());
+    Hash160Batch(hashes.data(), inputs.data(), inputs.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        const unsigned char* hash = &hashes[CHash160::OUTPUT_SIZE * i];
+        values[i].data.assign(hash, hash + CHash160::OUTPUT_SIZE);
+    }
+}
+
 Value Value::prepare_extraction(const Value& a, const Value& b) {
     CScript s;
     s << a.data_value() << b.data_value();
@@ -345,6 +345,8 @@ struct Value {
         do_sha256();
         do_ripemd160();
     }
+    /** HASH160 each of values, all at once (see Hash160Batch). */
+    static void do_hash160(std::vector<Value>& values);
     void do_base58enc() {
         data_value();
         str = EncodeBase58(data);